@@ -67,6 +67,10 @@ Mat4 Camera::getProjectionMatrix() const {
     return projMatrix;
 }
 
+Frustum Camera::getFrustum() const {
+    return Frustum::fromMatrices(projMatrix, viewMatrix);
+}
+
 void Camera::updateViewMatrix() {
     float cp = std::cos(pitch), sp = std::sin(pitch);
     float cy = std::cos(yaw), sy = std::sin(yaw);
@@ -3,6 +3,7 @@
 
 #include "maths/vec.hpp"
 #include "maths/mat4.hpp"
+#include "maths/frustum.hpp"
 
 class Camera {
 public:
@@ -19,6 +20,7 @@ public:
 
     Mat4 getViewMatrix() const;
     Mat4 getProjectionMatrix() const;
+    Frustum getFrustum() const;
 
     void updateViewMatrix();
 
@@ -1,7 +1,7 @@
 #include <glad/glad.h>
 
-#include "Camera.hpp"
-#include "Player.hpp"
+#include "camera.hpp"
+#include "player.hpp"
 #include "render/shader_program.hpp"
 #include "render/texture_2d.hpp"
 #include "window/cross_platform_window.hpp"
@@ -10,23 +10,46 @@
 #include "world/particle.hpp"
 
 
+/*
+ * Chunk vertices come in packed (see Chunk::Vertex), the position is unpacked relative to the chunk and the
+ * texture coordinates are worked out from it so merged faces repeat their tile. Every chunk is drawn in one call,
+ * so the chunk's origin is looked up from the slot its vertices carry.
+ */
 static const std::string vertexSource =
     "#version 330 core\n"
     "\n"
-    "layout (location = 0) in vec3 a_position;\n"
-    "layout (location = 1) in vec3 a_texture_coordinates;\n" // Remmber that the 3rd element is the ao (ambient occlusion).
-    "layout (location = 2) in vec3 a_tint;\n" // Remmber that the 3rd element is the ao (ambient occlusion).
+    "layout (location = 0) in uvec2 a_packed;\n"
     "\n"
-    "out vec3 f_texture_coordinates;\n"
-    "out vec3 f_tint;\n"
+    "out vec2 f_texture_coordinates;\n"
+    "flat out vec2 f_tile;\n"
+    "out float f_tint;\n"
     "\n"
     "uniform mat4 u_projection;\n"
     "uniform mat4 u_view;\n"
+    "uniform samplerBuffer u_chunk_origins;\n" // Indexed by the chunk's slot, see VertexArena.
+    "uniform float u_block_scale;\n"
+    "uniform int u_atlas_columns;\n"
+    "uniform vec2 u_tile_size;\n"
     "\n"
     "void main() {\n"
-    "   f_texture_coordinates = a_texture_coordinates;\n"
-    "   f_tint = a_tint;\n"
-    "   gl_Position = u_projection * u_view * vec4(a_position, 1);\n"
+    "   uint data = a_packed.x;\n"
+    "   vec3 position = vec3(data & 31u, (data >> 5u) & 31u, (data >> 10u) & 31u);\n"
+    "   uint face = (data >> 15u) & 7u;\n"
+    "   uint ao = (data >> 18u) & 3u;\n" // How many of the corner's neighbours are solid.
+    "   int tile = int((data >> 20u) & 255u);\n"
+    "\n"
+    "   if (face == 0u) f_texture_coordinates = position.xy;\n" // -Z (back)
+    "   else if (face == 1u) f_texture_coordinates = vec2(-position.x, position.y);\n" // +Z (front)
+    "   else if (face == 2u) f_texture_coordinates = vec2(position.x, -position.z);\n" // -Y (bottom)
+    "   else if (face == 3u) f_texture_coordinates = position.xz;\n" // +Y (top)
+    "   else if (face == 4u) f_texture_coordinates = vec2(-position.z, position.y);\n" // -X (left)
+    "   else f_texture_coordinates = position.zy;\n" // +X (right)
+    "\n"
+    "   vec3 chunk_origin = texelFetch(u_chunk_origins, int(a_packed.y >> 8u)).xyz;\n"
+    "\n"
+    "   f_tile = vec2(tile % u_atlas_columns, tile / u_atlas_columns) * u_tile_size;\n"
+    "   f_tint = float(a_packed.y & 255u) / 100.0 * (1.0 - 0.2 * float(ao));\n"
+    "   gl_Position = u_projection * u_view * vec4(chunk_origin + position * u_block_scale, 1);\n"
     "}";
 
 static const std::string fragmentSource =
@@ -34,13 +57,16 @@ static const std::string fragmentSource =
     "\n"
     "out vec4 frag_color;\n"
     "\n"
-    "in vec3 f_texture_coordinates;\n"
-    "in vec3 f_tint;\n"
+    "in vec2 f_texture_coordinates;\n"
+    "flat in vec2 f_tile;\n"
+    "in float f_tint;\n"
     "\n"
     "uniform sampler2D u_texture_atlas;\n"
+    "uniform vec2 u_tile_size;\n"
     "\n"
     "void main() {\n"
-    "   vec4 texture_color = texture(u_texture_atlas, f_texture_coordinates.xy);\n"
+    "   vec2 uv = f_tile + fract(f_texture_coordinates) * u_tile_size;\n" // Repeat the tile across merged faces.
+    "   vec4 texture_color = texture(u_texture_atlas, uv);\n"
     "   frag_color = vec4(texture_color.rgb * f_tint, 1);\n"
     "}";
 
@@ -84,7 +110,10 @@ int main() {
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
-    World world(3, 3);
+    World world(8, 3);
+    world.setStreaming(true); // Chunks within 8 of the player, the world size only matters without streaming.
+    world.setSaveDirectory("../saves"); // Edits are saved as their chunks unload and when the world closes.
+    world.setMemoryBudget(256 * 1024 * 1024); // Far chunks give up their meshes, then their blocks, past this.
     world.initChunks();
 
     // Rendering
@@ -113,6 +142,11 @@ int main() {
     std::cout << "Left click to break blocks.\n";
     std::cout << "Right click to place blocks.\n";
     std::cout << "The block type can be changed with the 't' key on your keyboard.\n";
+    std::cout << "The 'g' key switches between greedy and per-face chunk meshing.\n";
+    std::cout << "The 'b' key switches between the bitmask and per-block face culling kernels.\n";
+    std::cout << "The 'l' key switches ambient occlusion on and off.\n";
+    std::cout << "The 'c' key switches cave culling of hidden chunks on and off.\n";
+    std::cout << "The 'o' key switches occlusion query culling of hidden chunks on and off.\n";
     std::cout << "Enjoy!\n";
 
     while (window.isWindowOpen()) {
@@ -125,6 +159,7 @@ int main() {
         player.handleMouseInput(window);
         player.handleKeyboardInput(window);
         player.update(world, window, particleSystem);
+        world.update();
 
         shaderProgram.use();
         shaderProgram.setUniformMatrix4("u_projection", camera.getProjectionMatrix().m);
@@ -132,9 +167,14 @@ int main() {
 
         texture.bind(0);
         shaderProgram.setUniform("u_texture_atlas", 0);
+        shaderProgram.setUniform("u_block_scale", Block::BLOCK_SCALE);
+        shaderProgram.setUniform("u_atlas_columns", Block::atlasColumns);
+        shaderProgram.setUniform("u_tile_size",
+            static_cast<float>(Block::tileSize) / Block::textureWidth,
+            static_cast<float>(Block::tileSize) / Block::textureHeight);
 
         // Render the world (which handles chunks loading/unloading).
-        world.render(camera.getPosition());
+        world.render(shaderProgram, camera.getPosition(), camera.getFrustum());
 
         particleShader.use();
         particleShader.setUniformMatrix4("u_projection", camera.getProjectionMatrix().m);
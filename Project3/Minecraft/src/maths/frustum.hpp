@@ -0,0 +1,50 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "vec.hpp"
+#include "mat4.hpp"
+
+/*
+ * The six planes bounding what a camera can see, each stored as (a, b, c, d) with a point inside when
+ * ax + by + cz + d >= 0. The planes are not normalized, only the sign is ever looked at.
+ */
+struct Frustum {
+    Vec4f planes[6];
+
+    // Extracted from the combined clip matrix (Gribb and Hartmann), matrices are column major as GL takes them.
+    static Frustum fromMatrices(const Mat4 &projection, const Mat4 &view) {
+        // Rows of projection * view.
+        float clip[4][4];
+        for (int row = 0; row < 4; ++row)
+            for (int col = 0; col < 4; ++col) {
+                clip[row][col] = 0.0f;
+                for (int k = 0; k < 4; ++k)
+                    clip[row][col] += projection.m[k * 4 + row] * view.m[col * 4 + k];
+            }
+
+        // Left, right, bottom, top, near, far: the w row plus or minus the x, y and z rows.
+        Frustum frustum;
+        for (int axis = 0; axis < 3; ++axis)
+            for (int side = 0; side < 2; ++side) {
+                float sign = side == 0 ? 1.0f : -1.0f;
+                Vec4f &plane = frustum.planes[axis * 2 + side];
+                for (int col = 0; col < 4; ++col)
+                    plane[col] = clip[3][col] + sign * clip[axis][col];
+            }
+        return frustum;
+    }
+
+    // False only when the box is wholly outside one of the planes, boxes near a corner may pass when they are out.
+    bool intersectsBox(const Vec3f &min, const Vec3f &max) const {
+        for (const Vec4f &plane : planes) {
+            // The corner furthest along the plane's normal, if that is outside the whole box is.
+            float x = plane[0] >= 0.0f ? max[0] : min[0];
+            float y = plane[1] >= 0.0f ? max[1] : min[1];
+            float z = plane[2] >= 0.0f ? max[2] : min[2];
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -36,6 +36,17 @@ void Player::handleKeyboardInput(CrossPlatformWindow& window) {
         }
     }
 
+    // Toggling 'g' falls back to one quad per face, to compare against greedy meshing.
+    world.setMeshingMode(window.getKeyToggled(KEY_VAL_G) ? Chunk::MeshingMode::NAIVE : Chunk::MeshingMode::GREEDY);
+    // And 'b' falls back to checking faces one block at a time instead of the bitmask kernel.
+    world.setCullingKernel(window.getKeyToggled(KEY_VAL_B) ? Chunk::CullingKernel::PER_BLOCK : Chunk::CullingKernel::BITMASK);
+    // And 'l' meshes without ambient occlusion.
+    world.setAmbientOcclusion(!window.getKeyToggled(KEY_VAL_L));
+    // And 'c' draws every chunk in the frustum, hidden or not, to compare against cave culling.
+    world.setCaveCulling(!window.getKeyToggled(KEY_VAL_C));
+    // 'o' skips chunks hidden behind others last frame, found with occlusion queries.
+    world.setOcclusionCulling(window.getKeyToggled(KEY_VAL_O));
+
     if (window.getKeyPresssed(KEY_VAL_SPACE)) { camera.move(0, moveSpeed, 0); }
     if (window.getKeyPresssed(KEY_VAL_LSHIFT)) { camera.move(0, -moveSpeed, 0); }
 }
@@ -56,16 +67,19 @@ void Player::update(World &world, CrossPlatformWindow& window, ParticleSystem &p
             // Invalid chunk provided, exit function.
             if (chunk == nullptr) return;
 
+            // World block coordinates of the hit block, edits go through the world so neighbouring chunks get updated.
+            const Vec3i worldBlock = collidedBlock + chunk->getChunkPos() * Chunk::CHUNK_SIZE;
+
             if (window.getMouse().buttons[CrossPlatformWindow::MOUSE_LEFT]) {
 
                 // Break the block.
-                chunk->getBlock(collidedBlock[0], collidedBlock[1], collidedBlock[2]).type = Block::AIR;
+                world.setBlock(worldBlock[0], worldBlock[1], worldBlock[2], Block::AIR);
                 didAction = true;
 
                 const Vec3f particleOrigin = {
-                    static_cast<float>(collidedBlock[0] + chunk->getChunkPos()[0] * Chunk::CHUNK_SIZE),
-                    static_cast<float>(collidedBlock[1] + chunk->getChunkPos()[1] * Chunk::CHUNK_SIZE),
-                    static_cast<float>(collidedBlock[2] + chunk->getChunkPos()[2] * Chunk::CHUNK_SIZE)
+                    static_cast<float>(worldBlock[0]),
+                    static_cast<float>(worldBlock[1]),
+                    static_cast<float>(worldBlock[2])
                 };
                 setParticlesOnBlockBreak(particleSystem, particleOrigin);
             }
@@ -76,13 +90,13 @@ void Player::update(World &world, CrossPlatformWindow& window, ParticleSystem &p
             normal[2] = -normal[2];
 
             if (window.getMouse().buttons[CrossPlatformWindow::MOUSE_RIGHT]) {
-                Vec3i placePos = collidedBlock + normal;
-                chunk->getBlock(placePos[0], placePos[1], placePos[2]).type = placingBlockType;
+                Vec3i placePos = worldBlock + normal;
+                world.setBlock(placePos[0], placePos[1], placePos[2], placingBlockType);
                 didAction = true;
             }
 
             if (didAction) {
-                chunk->reloadMesh();  // Reload the mesh for the correct chunk
+                // The meshes of the touched chunks are rebuilt by World::update.
                 lastActionTime = now;
             }
         }
@@ -121,13 +135,15 @@ bool Player::rayCast(Chunk **hitChunk, Vec3i &hitPos, Vec3i &hitNormal, CrossPla
 
         // Compute chunk position
         int chunkX = blockX / Chunk::CHUNK_SIZE;
+        int chunkY = blockY / Chunk::CHUNK_SIZE;
         int chunkZ = blockZ / Chunk::CHUNK_SIZE;
 
         // Adjust for negative coordinates
         if (blockX < 0 && blockX % Chunk::CHUNK_SIZE != 0) chunkX--;
+        if (blockY < 0 && blockY % Chunk::CHUNK_SIZE != 0) chunkY--;
         if (blockZ < 0 && blockZ % Chunk::CHUNK_SIZE != 0) chunkZ--;
 
-        Chunk *chunk = world.getChunk(World::chunkKey(chunkX, chunkZ));
+        Chunk *chunk = world.getChunk(chunkX, chunkY, chunkZ);
         if (!chunk) continue;
 
         // Local block coords
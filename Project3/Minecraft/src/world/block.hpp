@@ -39,6 +39,7 @@ struct Block {
 
     // Constructor to initialize block type to AIR by default
     Block() : type(Block::AIR) {}
+    Block(BlockType type) : type(type) {}
 
     // Get texture coordinates for different block types.
     static BlockTexture getTextureCoords(BlockType type) {
@@ -48,6 +49,14 @@ struct Block {
     static constexpr int textureWidth = 128;
     static constexpr int textureHeight = 128;
 
+    // Every texture in the atlas is a tile of this size, numbered left to right then bottom to top.
+    static constexpr int tileSize = 32;
+    static constexpr int atlasColumns = textureWidth / tileSize;
+
+    static int getTileIndex(const TextureCoords &coords) {
+        return (coords.x / tileSize) + (coords.y / tileSize) * atlasColumns;
+    }
+
 };
 
 
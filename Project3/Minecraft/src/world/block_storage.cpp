@@ -0,0 +1,124 @@
+#include "block_storage.hpp"
+
+// std
+#include <algorithm>
+
+BlockStorage::BlockStorage(int size, Block::BlockType fill)
+    : size(size), bits(0), entriesPerWordShift(0), entryMask(0), palette{ fill }, paletteCounts{ static_cast<uint16_t>(size) } {
+    // Starts out uniform, with no indices.
+}
+
+BlockStorage::BlockStorage(const std::vector<Block::BlockType> &types)
+    : size(static_cast<int>(types.size())), bits(0), entriesPerWordShift(0), entryMask(0) {
+    int counts[Block::NUM_BLOCKS] = {};
+    for (Block::BlockType type : types) {
+        counts[type]++;
+    }
+
+    int entries[Block::NUM_BLOCKS] = {};
+    for (int type = 0; type < Block::NUM_BLOCKS; type++) {
+        if (counts[type] == 0) continue;
+
+        entries[type] = static_cast<int>(palette.size());
+        palette.push_back(static_cast<Block::BlockType>(type));
+        paletteCounts.push_back(static_cast<uint16_t>(counts[type]));
+    }
+
+    if (palette.size() == 1) return;
+
+    int newBits = 1;
+    while (palette.size() > (size_t(1) << newBits)) newBits *= 2;
+    setLayout(newBits);
+
+    // Whole words at a time, there is nothing in them to keep.
+    int entriesPerWord = 1 << entriesPerWordShift;
+    for (size_t word = 0; word < words.size(); word++) {
+        uint32_t packed = 0;
+        int first = static_cast<int>(word) * entriesPerWord;
+        int count = std::min(entriesPerWord, size - first);
+        for (int i = 0; i < count; i++) {
+            packed |= static_cast<uint32_t>(entries[types[first + i]]) << (i * bits);
+        }
+        words[word] = packed;
+    }
+}
+
+void BlockStorage::set(int index, Block::BlockType type) {
+    int oldEntry = bits == 0 ? 0 : getEntry(index);
+    if (palette[oldEntry] == type) return;
+
+    if (bits == 0) setBitsPerBlock(1);
+
+    int entry = findOrAddEntry(type);
+    paletteCounts[oldEntry]--;
+    paletteCounts[entry]++;
+
+    // The last block of every other type was just overwritten.
+    if (paletteCounts[entry] == size) {
+        palette.assign(1, type);
+        paletteCounts.assign(1, static_cast<uint16_t>(size));
+        setBitsPerBlock(0);
+        return;
+    }
+
+    setEntry(index, entry);
+}
+
+size_t BlockStorage::getMemoryUsage() const {
+    return palette.capacity() * sizeof(Block::BlockType) + paletteCounts.capacity() * sizeof(uint16_t) + words.capacity() * sizeof(uint32_t);
+}
+
+int BlockStorage::findOrAddEntry(Block::BlockType type) {
+    int freeEntry = -1;
+    for (int entry = 0; entry < static_cast<int>(palette.size()); entry++) {
+        if (paletteCounts[entry] == 0) {
+            if (freeEntry < 0) freeEntry = entry;
+        } else if (palette[entry] == type) {
+            return entry;
+        }
+    }
+
+    if (freeEntry >= 0) {
+        palette[freeEntry] = type;
+        return freeEntry;
+    }
+
+    palette.push_back(type);
+    paletteCounts.push_back(0);
+
+    int newBits = bits;
+    while (palette.size() > (size_t(1) << newBits)) newBits *= 2;
+    if (newBits != bits) setBitsPerBlock(newBits);
+
+    return static_cast<int>(palette.size()) - 1;
+}
+
+void BlockStorage::setBitsPerBlock(int newBits) {
+    if (newBits == 0) {
+        bits = 0;
+        entriesPerWordShift = 0;
+        entryMask = 0;
+        std::vector<uint32_t>().swap(words);
+        return;
+    }
+
+    std::vector<int> entries(size, 0);
+    for (int index = 0; index < size && bits != 0; index++) {
+        entries[index] = getEntry(index);
+    }
+
+    setLayout(newBits);
+    for (int index = 0; index < size; index++) {
+        setEntry(index, entries[index]);
+    }
+}
+
+void BlockStorage::setLayout(int newBits) {
+    bits = newBits;
+    entryMask = (bits == 32) ? ~0u : (1u << bits) - 1;
+    entriesPerWordShift = 0;
+    while ((32 >> entriesPerWordShift) > bits) entriesPerWordShift++;
+
+    int entriesPerWord = 1 << entriesPerWordShift;
+    words.assign((size + entriesPerWord - 1) / entriesPerWord, 0);
+}
@@ -0,0 +1,74 @@
+#ifndef BLOCK_STORAGE_HPP
+#define BLOCK_STORAGE_HPP
+
+#include "block.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Block types stored as indices into a palette of the types that actually appear. The indices are bit packed
+ * and only widen (1, 2, 4, 8 then 16 bits) once the palette outgrows them, so a chunk of a handful of types
+ * takes 0.5 to 2 KB instead of 4 bytes a block. Entries no block uses any more are reused before the palette grows.
+ * Storage where every block is the same type (all air or all stone) has no indices at all, the first differing
+ * write brings them back and they are dropped again once the blocks are uniform.
+ */
+class BlockStorage {
+public:
+    explicit BlockStorage(int size, Block::BlockType fill = Block::AIR);
+
+    // Packs a whole array of types at once, the palette is built in one pass instead of block by block.
+    explicit BlockStorage(const std::vector<Block::BlockType> &types);
+
+    Block::BlockType get(int index) const {
+        if (bits == 0) return palette[0];
+        return palette[getEntry(index)];
+    }
+
+    void set(int index, Block::BlockType type);
+
+    // Every block is getUniformType().
+    bool isUniform() const { return bits == 0; }
+    Block::BlockType getUniformType() const { return palette[0]; }
+
+    int getBitsPerBlock() const { return bits; }
+    int getPaletteSize() const { return static_cast<int>(palette.size()); }
+
+    // Bytes held by the palette and the packed indices.
+    size_t getMemoryUsage() const;
+
+private:
+    int size;
+    int bits;
+    int entriesPerWordShift; // log2 of the indices in a 32 bit word.
+    uint32_t entryMask;
+
+    std::vector<Block::BlockType> palette;
+    std::vector<uint16_t> paletteCounts; // Blocks using each entry, 0 when it is free.
+    std::vector<uint32_t> words;
+
+    int getEntry(int index) const {
+        uint32_t word = words[index >> entriesPerWordShift];
+        int shift = (index & ((1 << entriesPerWordShift) - 1)) * bits;
+        return static_cast<int>((word >> shift) & entryMask);
+    }
+
+    void setEntry(int index, int entry) {
+        uint32_t &word = words[index >> entriesPerWordShift];
+        int shift = (index & ((1 << entriesPerWordShift) - 1)) * bits;
+        word = (word & ~(entryMask << shift)) | (static_cast<uint32_t>(entry) << shift);
+    }
+
+    // Palette entry for a type, adding it (and widening the indices if needed) when it isn't there.
+    int findOrAddEntry(Block::BlockType type);
+
+    // Repacks every index at a new width, 0 drops them (only when every block uses entry 0).
+    void setBitsPerBlock(int newBits);
+
+    // Sets the index width and clears the words to match, without keeping any indices.
+    void setLayout(int newBits);
+};
+
+#endif
@@ -1,154 +1,408 @@
 #include "chunk.hpp"
+#include "chunk_mesher.hpp"
+#include "chunk_visibility.hpp"
+#include "vertex_arena.hpp"
+
+// std
+#include <algorithm>
+#include <utility>
+
+Chunk::MeshingMode Chunk::meshingMode = Chunk::MeshingMode::GREEDY;
+Chunk::CullingKernel Chunk::cullingKernel = Chunk::CullingKernel::BITMASK;
+bool Chunk::ambientOcclusion = true;
+GLuint Chunk::quadIndexBuffer = 0;
+uint32_t Chunk::lastMeshVersion = 0;
+
+Chunk::Chunk(VertexArena &arena, int x, int y, int z, BlockStorage &&blocks)
+    : arena(&arena), slot(arena.allocateSlot()), blocks(std::move(blocks)), chunkPosition(x, y, z) {
+    // The mesh is built later by the world, once the neighbours are loaded.
+    setOrigin();
+}
 
-Chunk::Chunk(int x, int y, int z) : chunkPosition(x, y, z) {
-    // Generate terrain
-    for (int x = 0; x < CHUNK_SIZE; x++) {
-        for (int y = 0; y < CHUNK_SIZE; y++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                int index = x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE);
-                blocks[index].type = (y == 7) ? Block::GRASS : (y < 7 && y >= 5) ? Block::DIRT : (y < 5) ? Block::STONE : Block::AIR;
-            }
-        }
+void Chunk::setOrigin() {
+    arena->setOrigin(slot,
+        static_cast<float>(chunkPosition[0] * CHUNK_SIZE) * Block::BLOCK_SCALE,
+        static_cast<float>(chunkPosition[1] * CHUNK_SIZE) * Block::BLOCK_SCALE,
+        static_cast<float>(chunkPosition[2] * CHUNK_SIZE) * Block::BLOCK_SCALE);
+}
+
+void Chunk::reset(int x, int y, int z, BlockStorage &&blocks) {
+    chunkPosition = Vec3i(x, y, z);
+    this->blocks = std::move(blocks);
+    setOrigin();
+
+    // The range and the sections' room in it stay, only the meshes go.
+    meshVersion = ++lastMeshVersion;
+    for (MeshSection &section : sections) {
+        section.vertices.clear();
+        section.version = meshVersion; // Meshes still in flight for the old position never match.
     }
+    dirtySections = ALL_SECTIONS;
+    lodLevel = 0;
+    editedBlocks.clear();
+    unsavedChanges = false;
+    meshDropped = false;
+    lastUsedFrame = 0;
+    visibility = ~0ull;
+    visibilityStale = true;
+
+    // A result still to come is about the old position.
+    deleteOcclusionQuery();
+    occluded = false;
+    occlusionFrame = 0;
+}
+
+void Chunk::setBlock(int x, int y, int z, Block::BlockType type) {
+    int index = x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE);
+    blocks.set(index, type);
+
+    auto edited = std::lower_bound(editedBlocks.begin(), editedBlocks.end(), static_cast<uint16_t>(index));
+    if (edited == editedBlocks.end() || *edited != index) editedBlocks.insert(edited, static_cast<uint16_t>(index));
+    unsavedChanges = true;
+    visibilityStale = true;
+}
+
+void Chunk::setVisibility(uint64_t graph, uint32_t version) {
+    if (version != meshVersion) return;
+
+    // An edit since the job's snapshot is waiting for its own remesh, which has to work the graph out again.
+    visibility = graph;
+    visibilityStale = isDirty();
+}
 
-    // generate vertices
+void Chunk::updateVisibility() {
+    setVisibility(ChunkVisibility::fromBlocks(blocks));
+}
 
-    glGenBuffers(1, &vbo);
-    glGenVertexArrays(1, &vao);
+void Chunk::dropMesh() {
+    meshVersion = ++lastMeshVersion;
+    for (MeshSection &section : sections) {
+        std::vector<Vertex>().swap(section.vertices);
+        section.version = meshVersion;
+        section.firstVertex = 0;
+        section.capacity = 0;
+    }
 
-    glBindVertexArray(vao);
+    releaseRange();
 
-    reloadMesh();
+    // Remeshing it is up to the world, a partial remesh would leave the other sections empty.
+    dirtySections = 0;
+    meshDropped = true;
+}
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, position));
+size_t Chunk::getVertexCount() const {
+    size_t count = 0;
+    for (const MeshSection &section : sections) {
+        count += section.vertices.size();
+    }
+    return count;
+}
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, texture));
+size_t Chunk::getMeshMemoryUsage() const {
+    size_t bytes = 0;
+    for (const MeshSection &section : sections) {
+        bytes += section.vertices.capacity() * sizeof(Vertex);
+    }
+    return bytes;
+}
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, color));
+size_t Chunk::getBlockMemoryUsage() const {
+    return sizeof(Chunk) + blocks.getMemoryUsage() + editedBlocks.capacity() * sizeof(uint16_t);
 }
 
 void Chunk::destroy() {
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
+    releaseRange();
+    arena->releaseSlot(slot);
+    deleteOcclusionQuery();
+}
+
+void Chunk::releaseRange() {
+    arena->release(rangeFirst, rangeCount);
+    rangeFirst = 0;
+    rangeCount = 0;
+}
+
+void Chunk::deleteOcclusionQuery() {
+    if (occlusionQuery != 0) glDeleteQueries(1, &occlusionQuery);
+    occlusionQuery = 0;
+    occlusionQueryPending = false;
 }
 
 void Chunk::render() {
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+    // One draw for all the sections, each one indexes from its own first vertex.
+    GLsizei counts[SECTION_COUNT];
+    const void *indices[SECTION_COUNT];
+    GLint baseVertices[SECTION_COUNT];
+    GLsizei drawCount = 0;
+
+    for (const MeshSection &section : sections) {
+        if (section.vertices.empty()) continue;
+
+        counts[drawCount] = static_cast<GLsizei>(section.vertices.size() / 4 * 6);
+        indices[drawCount] = nullptr;
+        baseVertices[drawCount] = section.firstVertex;
+        drawCount++;
+    }
+    if (drawCount == 0) return;
+
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_SHORT, indices, drawCount, baseVertices);
 }
 
-void Chunk::reloadMesh() {
-    vertices.clear();
+void Chunk::addDraws(DrawList &draws) const {
+    for (const MeshSection &section : sections) {
+        if (!section.vertices.empty()) draws.add(static_cast<GLsizei>(section.vertices.size() / 4 * 6), section.firstVertex);
+    }
+}
 
-    auto isBlockVisible = [&](int x, int y, int z) {
-        if (x < 0 || y < 0 || z < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE)
-            return true; // Face on edge of chunk.
+void Chunk::renderBoundingBox() {
+    if (rangeCount == 0) return;
 
-        int index = x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE;
-        return blocks[index].type == Block::AIR;
-    };
+    glDrawElementsBaseVertex(GL_TRIANGLES, BOX_VERTICES / 4 * 6, GL_UNSIGNED_SHORT, nullptr, boxFirstVertex);
+}
+
+void Chunk::beginOcclusionQuery() {
+    if (occlusionQuery == 0) glGenQueries(1, &occlusionQuery);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusionQuery);
+}
+
+void Chunk::endOcclusionQuery() {
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    occlusionQueryPending = true;
+}
+
+void Chunk::collectOcclusionQuery(uint64_t frame) {
+    if (occlusionFrame + 1 != frame) occluded = false;
+    occlusionFrame = frame;
+    if (!occlusionQueryPending) return;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(occlusionQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+
+    GLuint samplesPassed = 0;
+    glGetQueryObjectuiv(occlusionQuery, GL_QUERY_RESULT, &samplesPassed);
+    occluded = samplesPassed == 0;
+    occlusionQueryPending = false;
+}
+
+GLuint Chunk::getQuadIndexBuffer() {
+    if (quadIndexBuffer != 0) return quadIndexBuffer;
+
+    // Every quad is 4 vertices in a row, so the indices are the same pattern offset by 4 each time.
+    std::vector<uint16_t> indices(MAX_QUADS * 6);
+    for (int quad = 0; quad < MAX_QUADS; quad++) {
+        uint16_t base = static_cast<uint16_t>(quad * 4);
+        indices[quad * 6 + 0] = base + 0;
+        indices[quad * 6 + 1] = base + 1;
+        indices[quad * 6 + 2] = base + 2;
+        indices[quad * 6 + 3] = base + 2;
+        indices[quad * 6 + 4] = base + 1;
+        indices[quad * 6 + 5] = base + 3;
+    }
+
+    glGenBuffers(1, &quadIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+    return quadIndexBuffer;
+}
+
+void Chunk::destroyQuadIndexBuffer() {
+    if (quadIndexBuffer == 0) return;
+
+    glDeleteBuffers(1, &quadIndexBuffer);
+    quadIndexBuffer = 0;
+}
+
+void Chunk::reloadMesh(const Neighbours &neighbours) {
+    if (visibilityStale) updateVisibility();
+
+    uint32_t version = beginRemesh(ALL_SECTIONS);
+    if (isMeshEmpty(neighbours)) {
+        uploadMesh(ALL_SECTIONS, version, SectionMeshes());
+        return;
+    }
+
+    int scale = lodScale(lodLevel);
+    PaddedBlocks padded = scale == 1 ? buildPaddedBlocks(neighbours) : buildDownsampledBlocks(neighbours, scale);
+    uploadMesh(ALL_SECTIONS, version, ChunkMesher::buildMesh(padded, meshingMode, cullingKernel, ambientOcclusion, ALL_SECTIONS, scale));
+}
+
+bool Chunk::isMeshEmpty(const Neighbours &neighbours) const {
+    if (!blocks.isUniform()) return false;
+    if (blocks.getUniformType() == Block::AIR) return true;
+
+    // A missing neighbour counts as air, so the faces towards it are drawn.
+    static const int sides[6][3] = { {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0} };
+    for (const auto &side : sides) {
+        const Chunk *neighbour = neighbours[neighbourIndex(side[0], side[1], side[2])];
+        if (neighbour == nullptr || !neighbour->blocks.isUniform() || neighbour->blocks.getUniformType() == Block::AIR) return false;
+    }
+    return true;
+}
+
+uint32_t Chunk::beginRemesh(uint32_t sectionMask) {
+    dirtySections &= ~sectionMask;
+    if (sectionMask == ALL_SECTIONS) meshDropped = false;
+    meshVersion = ++lastMeshVersion;
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        if (sectionMask & (1u << i)) sections[i].version = meshVersion;
+    }
+    return meshVersion;
+}
+
+void Chunk::markDirty(int minY, int maxY) {
+    if (maxY < 0 || minY >= CHUNK_SIZE) return;
+    if (meshDropped) {
+        dirtySections = ALL_SECTIONS;
+        return;
+    }
+
+    int first = std::max(minY, 0) / SECTION_HEIGHT;
+    int last = std::min(maxY, CHUNK_SIZE - 1) / SECTION_HEIGHT;
+    for (int i = first; i <= last; i++) {
+        dirtySections |= 1u << i;
+    }
+}
+
+void Chunk::uploadMesh(uint32_t sectionMask, uint32_t version, SectionMeshes &&meshes) {
+    // Without a slot its vertices can't say where the chunk is. It isn't drawn until a remesh finds one free.
+    if (slot == VertexArena::NO_SLOT) {
+        slot = arena->allocateSlot();
+        if (slot == VertexArena::NO_SLOT) return;
+        setOrigin();
+    }
 
+    uint32_t uploaded = 0;
+    bool fits = true;
 
-    auto addFace = [&](int x, int y, int z, int face, Block::BlockType type) {
-        // Get texture coordinates and dimensions for the block type
-        BlockTexture textureCoords = Block::getTextureCoords(type);
-
-        // Corrected texture vertices for each face
-        static const float faceVertices[6][6][3] = {
-            // -Z (back)
-            {{0,0,0}, {1,0,0}, {0,1,0}, {0,1,0}, {1,0,0}, {1,1,0}},
-            // +Z (front)
-            {{0,0,1}, {0,1,1}, {1,0,1}, {1,0,1}, {0,1,1}, {1,1,1}},
-
-            // -Y (bottom)
-            {{0,0,0}, {0,0,1}, {1,0,0}, {1,0,0}, {0,0,1}, {1,0,1}},
-            // +Y (top)
-            {{0,1,0}, {1,1,0}, {0,1,1}, {0,1,1}, {1,1,0}, {1,1,1}},
-
-            // -X (left)
-            {{0,0,0}, {0,1,0}, {0,0,1}, {0,0,1}, {0,1,0}, {0,1,1}},
-            // +X (right)
-            {{1,0,0}, {1,0,1}, {1,1,0}, {1,1,0}, {1,0,1}, {1,1,1}},
-        };
-
-        static const float textureVertices[6][6][2] = {
-            // -Z (back)
-            {{0,0}, {1,0}, {0,1}, {0,1}, {1,0}, {1,1}},
-
-            // +Z (front) - flipped horizontally to correct orientation
-            {{1,0}, {1,1}, {0,0}, {0,0}, {1,1}, {0,1}},
-
-            // -Y (bottom)
-            {{0,1}, {0,0}, {1,1}, {1,1}, {0,0}, {1,0}},
-
-            // +Y (top)
-            {{0,0}, {1,0}, {0,1}, {0,1}, {1,0}, {1,1}},
-
-            // -X (left) - rotated to fix flipped texture
-            {{1,0}, {1,1}, {0,0}, {0,0}, {1,1}, {0,1}},
-
-            // +X (right) — reverted to original UVs
-            {{0, 0}, {1, 0}, {0, 1}, {0, 1}, {1, 0}, {1, 1}},
-        };
-
-        static const float faceBrightness[6] = {
-            0.3f, // -Z (back) — much darker
-            1.0f, // +Z (front) — unchanged
-            0.2f, // -Y (bottom) — very dark
-            1.2f, // +Y (top) — unchanged
-            0.4f, // -X (left) — darker
-            0.85f // +X (right) — slightly darker
-        };
-        for (int i = 0; i < 6; i++) {
-            Vertex v;
-
-            // Texture mapping (unchanged)
-            float u = (textureCoords[face].x + textureVertices[face][i][0] * textureCoords[face].width) / Block::textureWidth;
-            float vCoord = (textureCoords[face].y + textureVertices[face][i][1] * textureCoords[face].height) / Block::textureHeight;
-
-            v.texture[0] = u;
-            v.texture[1] = vCoord;
-
-            // World-space position
-            v.position[0] = (x + faceVertices[face][i][0] + chunkPosition[0] * CHUNK_SIZE) * Block::BLOCK_SCALE;
-            v.position[1] = (y + faceVertices[face][i][1] + chunkPosition[1] * CHUNK_SIZE) * Block::BLOCK_SCALE;
-            v.position[2] = (z + faceVertices[face][i][2] + chunkPosition[2] * CHUNK_SIZE) * Block::BLOCK_SCALE;
-
-            // Assign brightness as grayscale color
-            float brightness = faceBrightness[face];
-            v.color[0] = brightness;
-            v.color[1] = brightness;
-            v.color[2] = brightness;
-
-            vertices.push_back(v);
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        // A section remeshed again after this job was snapshotted gets its mesh from the newer job.
+        if (!(sectionMask & (1u << i)) || sections[i].version != version) continue;
+
+        sections[i].vertices = std::move(meshes[i]);
+        for (Vertex &vertex : sections[i].vertices) {
+            vertex.setSlot(slot);
         }
+        fits = fits && static_cast<GLsizei>(sections[i].vertices.size()) <= sections[i].capacity;
+        uploaded |= 1u << i;
+    }
+    if (uploaded == 0) return;
 
-    };
+    if (!fits) {
+        reallocateSections();
+        return;
+    }
+
+    // Everything fits where it already is, so only the changed sections are sent.
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        const MeshSection &section = sections[i];
+        if (!(uploaded & (1u << i))) continue;
 
-    // Loop through all blocks and add faces based on visibility
-    for (int x = 0; x < CHUNK_SIZE; x++) {
-        for (int y = 0; y < CHUNK_SIZE; y++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                int index = x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE;
-                Block &block = blocks[index];
-                if (block.type == Block::AIR)
+        arena->upload(section.firstVertex, section.vertices.data(), static_cast<GLsizei>(section.vertices.size()));
+    }
+}
+
+void Chunk::reallocateSections() {
+    // A quarter extra (in whole quads) leaves room for the faces a few edits add.
+    GLsizei total = 0;
+    for (MeshSection &section : sections) {
+        GLsizei quads = static_cast<GLsizei>(section.vertices.size() / 4);
+        section.firstVertex = total;
+        section.capacity = (quads + quads / 4 + 1) * 4;
+        total += section.capacity;
+    }
+
+    static const std::vector<Vertex> box = ChunkMesher::buildBoundingBox();
+    boxFirstVertex = total;
+    total += BOX_VERTICES;
+
+    releaseRange();
+    rangeFirst = arena->allocate(total);
+    rangeCount = total;
+
+    for (MeshSection &section : sections) {
+        section.firstVertex += rangeFirst;
+        arena->upload(section.firstVertex, section.vertices.data(), static_cast<GLsizei>(section.vertices.size()));
+    }
+
+    boxFirstVertex += rangeFirst;
+    std::vector<Vertex> slotBox = box;
+    for (Vertex &vertex : slotBox) {
+        vertex.setSlot(slot);
+    }
+    arena->upload(boxFirstVertex, slotBox.data(), BOX_VERTICES);
+}
+
+Chunk::PaddedBlocks Chunk::buildPaddedBlocks(const Neighbours &neighbours) const {
+    PaddedBlocks padded(PADDED_SIZE * PADDED_SIZE * PADDED_SIZE, Block::AIR);
+
+    for (int z = 0; z < CHUNK_SIZE; z++)
+        for (int y = 0; y < CHUNK_SIZE; y++)
+            for (int x = 0; x < CHUNK_SIZE; x++)
+                padded[ChunkMesher::paddedIndex(x, y, z)] = getBlock(x, y, z).type;
+
+    // Fill the border from whichever neighbour each cell falls in (faces, edges and corners).
+    auto chunkOffset = [](int coord) { return coord < 0 ? -1 : (coord >= CHUNK_SIZE ? 1 : 0); };
+
+    for (int z = -1; z <= CHUNK_SIZE; z++) {
+        for (int y = -1; y <= CHUNK_SIZE; y++) {
+            for (int x = -1; x <= CHUNK_SIZE; x++) {
+                int dx = chunkOffset(x), dy = chunkOffset(y), dz = chunkOffset(z);
+                if (dx == 0 && dy == 0 && dz == 0) {
+                    x = CHUNK_SIZE - 1; // Skip over the inside of the chunk.
                     continue;
+                }
+
+                const Chunk *neighbour = neighbours[neighbourIndex(dx, dy, dz)];
+                if (neighbour == nullptr) continue;
+
+                padded[ChunkMesher::paddedIndex(x, y, z)] = neighbour->getBlock(x - dx * CHUNK_SIZE, y - dy * CHUNK_SIZE, z - dz * CHUNK_SIZE).type;
+            }
+        }
+    }
+
+    return padded;
+}
+
+Chunk::PaddedBlocks Chunk::buildDownsampledBlocks(const Neighbours &neighbours, int scale) const {
+    PaddedBlocks padded(PADDED_SIZE * PADDED_SIZE * PADDED_SIZE, Block::AIR);
+    const int cells = CHUNK_SIZE / scale;
+
+    // Block at chunk-local coordinates that may be up to a chunk outside of this one.
+    auto chunkOffset = [](int coord) { return coord < 0 ? -1 : (coord >= CHUNK_SIZE ? 1 : 0); };
+    auto blockAt = [&](int x, int y, int z) {
+        int dx = chunkOffset(x), dy = chunkOffset(y), dz = chunkOffset(z);
+        const Chunk *chunk = neighbours[neighbourIndex(dx, dy, dz)];
+        if (chunk == nullptr) return Block::AIR;
+        return chunk->getBlock(x - dx * CHUNK_SIZE, y - dy * CHUNK_SIZE, z - dz * CHUNK_SIZE).type;
+    };
 
-                // Check neighbors and add visible faces.
-                if (isBlockVisible(x, y, z - 1)) addFace(x, y, z, 0, block.type);
-                if (isBlockVisible(x, y, z + 1)) addFace(x, y, z, 1, block.type);
-                if (isBlockVisible(x, y - 1, z)) addFace(x, y, z, 2, block.type);
-                if (isBlockVisible(x, y + 1, z)) addFace(x, y, z, 3, block.type);
-                if (isBlockVisible(x - 1, y, z)) addFace(x, y, z, 4, block.type);
-                if (isBlockVisible(x + 1, y, z)) addFace(x, y, z, 5, block.type);
+    for (int cz = -1; cz <= cells; cz++) {
+        for (int cy = -1; cy <= cells; cy++) {
+            for (int cx = -1; cx <= cells; cx++) {
+                int counts[Block::NUM_BLOCKS] = {};
+                int solid = 0;
+                Block::BlockType best = Block::AIR;
+
+                // Going up the cell, so a tie goes to the type nearer the top (grass over dirt).
+                for (int y = cy * scale; y < (cy + 1) * scale; y++) {
+                    for (int z = cz * scale; z < (cz + 1) * scale; z++) {
+                        for (int x = cx * scale; x < (cx + 1) * scale; x++) {
+                            Block::BlockType type = blockAt(x, y, z);
+                            if (type == Block::AIR) continue;
+
+                            solid++;
+                            if (++counts[type] >= counts[best]) best = type;
+                        }
+                    }
+                }
+
+                if (solid * 2 >= scale * scale * scale)
+                    padded[ChunkMesher::paddedIndex(cx, cy, cz)] = best;
             }
         }
     }
 
-    // Upload vertex data to GPU
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    return padded;
 }
@@ -2,49 +2,312 @@
 #define CHUNK_HPP
 
 #include "block.hpp"
+#include "block_storage.hpp"
 
 #include "../maths/vec.hpp"
+#include "../render/shader_program.hpp"
 
 #include <glad/glad.h>
 
 // std
+#include <array>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
+class VertexArena;
+
 class Chunk {
 public:
+    /*
+     * Vertices are packed into two words and unpacked in the vertex shader, positions are relative to the chunk
+     * origin which is passed in as a uniform.
+     * data:  x (5 bits) | y (5) | z (5) | face (3) | ao (2) | atlas tile (8)
+     * extra: brightness in hundredths (8 bits) | slot (24), the chunk's place in the arena's origin table.
+     * The texture coordinates are worked out in the shader from the position and the face.
+     */
     struct Vertex {
-        Vec3f position;
-        Vec3f texture; // The third element is for the ao occlusion.
-        Vec3f color;
+        uint32_t data;
+        uint32_t extra;
+
+        static Vertex pack(int x, int y, int z, int face, int ao, int tile, int brightness) {
+            return Vertex{
+                static_cast<uint32_t>(x | (y << 5) | (z << 10) | (face << 15) | (ao << 18) | (tile << 20)),
+                static_cast<uint32_t>(brightness & 0xFF),
+            };
+        }
+
+        int x() const { return data & 0x1F; }
+        int y() const { return (data >> 5) & 0x1F; }
+        int z() const { return (data >> 10) & 0x1F; }
+        int face() const { return (data >> 15) & 0x7; }
+        int ao() const { return (data >> 18) & 0x3; }
+        int tile() const { return (data >> 20) & 0xFF; }
+        int brightness() const { return extra & 0xFF; }
+        uint32_t slot() const { return extra >> 8; }
+
+        // The mesher leaves the slot at 0, the chunk fills it in as the mesh is uploaded.
+        void setSlot(uint32_t slot) { extra = (extra & 0xFF) | (slot << 8); }
+    };
+
+    // Draws for glMultiDrawElementsBaseVertex, each one indexes the quad index buffer from its base vertex.
+    struct DrawList {
+        std::vector<GLsizei> counts;
+        std::vector<const void *> indices;
+        std::vector<GLint> baseVertices;
+
+        void add(GLsizei count, GLint baseVertex) {
+            counts.push_back(count);
+            indices.push_back(nullptr);
+            baseVertices.push_back(baseVertex);
+        }
+
+        void clear() { counts.clear(); indices.clear(); baseVertices.clear(); }
+        bool empty() const { return counts.empty(); }
+    };
+
+    // How the faces of a chunk are turned into quads.
+    enum class MeshingMode {
+        NAIVE,  // One quad for every exposed face.
+        GREEDY, // Coplanar faces of the same block type are merged into larger quads.
+    };
+
+    // How the mesher finds which faces are exposed, both give the same faces.
+    enum class CullingKernel {
+        PER_BLOCK, // Looks at the neighbour of every face one at a time.
+        BITMASK,   // Shifts and masks whole columns of blocks at once.
     };
 
     static constexpr int CHUNK_SIZE = 16;
 
-    Chunk(int x, int y, int z);
+    // The chunk plus a one block border taken from its neighbours, used while meshing.
+    static constexpr int PADDED_SIZE = CHUNK_SIZE + 2;
+
+    // Block types of the chunk and its border, see buildPaddedBlocks.
+    typedef std::vector<Block::BlockType> PaddedBlocks;
+
+    // The 3x3x3 block of chunks around a chunk (see neighbourIndex), nullptr where none is loaded.
+    // Edge and corner chunks are needed too, ambient occlusion looks at diagonal blocks.
+    typedef std::array<const Chunk *, 27> Neighbours;
+
+    static int neighbourIndex(int dx, int dy, int dz) { return (dx + 1) + (dy + 1) * 3 + (dz + 1) * 9; }
+
+    // A checkerboard of blocks has the most faces a chunk can have, 4 vertices each keeps indices within 16 bits.
+    static constexpr int MAX_QUADS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * 3;
+
+    /*
+     * The mesh is split into horizontal sections of SECTION_HEIGHT layers so an edit only remeshes and
+     * re-uploads the sections around it. Sets of sections are bitmasks, bit i for section i.
+     */
+    static constexpr int SECTION_HEIGHT = 4;
+    static constexpr int SECTION_COUNT = CHUNK_SIZE / SECTION_HEIGHT;
+    static constexpr uint32_t ALL_SECTIONS = (1u << SECTION_COUNT) - 1;
+
+    // A mesh per section, only the ones in the accompanying section mask are filled in.
+    typedef std::array<std::vector<Vertex>, SECTION_COUNT> SectionMeshes;
+
+    // The bounding box kept after the sections in the chunk's range of the arena, for occlusion queries. Six quads.
+    static constexpr int BOX_VERTICES = 6 * 4;
+
+    // Level 0 is full detail, level n is meshed from cells of 2^n blocks a side (see buildDownsampledBlocks).
+    static constexpr int LOD_LEVELS = 3;
+
+    static int lodScale(int level) { return 1 << level; }
+
+    // The blocks come from a TerrainGenerator, usually run on a worker thread. The mesh goes in `arena`.
+    Chunk(VertexArena &arena, int x, int y, int z, BlockStorage &&blocks);
     void destroy();
 
+    // Turns the chunk into a new one at another position, keeping its room in the arena.
+    void reset(int x, int y, int z, BlockStorage &&blocks);
+
+    // Draws the chunk on its own, the arena has to be bound (see VertexArena::bind).
     void render();
-    void reloadMesh();
+
+    // Adds the chunk's draws to a list, to be drawn along with other chunks' by VertexArena::draw.
+    void addDraws(DrawList &draws) const;
+
+    // Draws the chunk's bounding box, for an occlusion query. Only chunks with a mesh have one.
+    void renderBoundingBox();
+
+    /*
+     * Wraps the draws of a frame in an occlusion query. Results are read a frame or more later, whenever the GL
+     * has them, so the CPU never waits on the GPU. Only one query is out at a time.
+     */
+    void beginOcclusionQuery();
+    void endOcclusionQuery();
+    bool isOcclusionQueryPending() const { return occlusionQueryPending; }
+
+    /*
+     * Picks up the result of the last query if it is in, otherwise the chunk stays as it was. A chunk that wasn't
+     * up for drawing the frame before counts as visible again, what it was then is too old to go by.
+     */
+    void collectOcclusionQuery(uint64_t frame);
+    bool isOccluded() const { return occluded; }
+    void setOccluded(bool hidden) { occluded = hidden; }
+
+    // Builds and uploads the mesh right away on the calling thread, the world meshes on worker threads instead.
+    void reloadMesh(const Neighbours &neighbours);
+
+    // True when the chunk can't have a face to draw: all air, or all solid with solid chunks on all six sides.
+    // Such chunks skip meshing altogether.
+    bool isMeshEmpty(const Neighbours &neighbours) const;
+
+    // Copies the blocks into a PADDED_SIZE^3 grid, the border is filled from the neighbours (air where missing).
+    PaddedBlocks buildPaddedBlocks(const Neighbours &neighbours) const;
+
+    /*
+     * Same layout as buildPaddedBlocks, but every cell stands for scale^3 blocks. Cells 0 to CHUNK_SIZE / scale - 1
+     * are the chunk, the border is at -1 and CHUNK_SIZE / scale and everything past it is air. A cell is solid
+     * when at least half its blocks are, with the most common solid type (the higher one on a tie).
+     */
+    PaddedBlocks buildDownsampledBlocks(const Neighbours &neighbours, int scale) const;
+
+    // Clears the dirty sections and returns the version their next meshes have to carry to be uploaded.
+    uint32_t beginRemesh(uint32_t sectionMask);
+
+    // GL half of meshing, must run on the render thread. Sections remeshed again since `version` are skipped.
+    void uploadMesh(uint32_t sectionMask, uint32_t version, SectionMeshes &&meshes);
+
+    // Dirty sections get their mesh rebuilt by the world before the next render.
+    void markDirty() { dirtySections = ALL_SECTIONS; }
+    // Marks the sections holding chunk-local layers minY to maxY, either end may be outside the chunk.
+    // A chunk whose mesh was dropped has nothing to patch, so it is marked whole.
+    void markDirty(int minY, int maxY);
+    bool isDirty() const { return dirtySections != 0; }
+    uint32_t getDirtySections() const { return dirtySections; }
+
+    // The world picks the level from the distance to the player, the chunk is meshed at it on the next remesh.
+    int getLodLevel() const { return lodLevel; }
+    void setLodLevel(int level) { lodLevel = level; }
+
+    /*
+     * Frees the mesh, on the CPU and in the arena, to save memory. The chunk draws nothing until it is remeshed
+     * whole, meshes already in flight are thrown away. The blocks stay.
+     */
+    void dropMesh();
+    bool isMeshDropped() const { return meshDropped; }
+
+    /*
+     * Which of the chunk's faces see each other through its air, see ChunkVisibility. Edits leave it stale until the
+     * chunk is remeshed, full detail meshes work it out on the worker alongside the mesh.
+     */
+    uint64_t getVisibility() const { return visibility; }
+    void setVisibility(uint64_t graph) { visibility = graph; visibilityStale = false; }
+    // A graph from a mesh job, dropped when the chunk has been remeshed again since `version`.
+    void setVisibility(uint64_t graph, uint32_t version);
+    bool isVisibilityStale() const { return visibilityStale; }
+    // Works the graph out from the blocks on the calling thread.
+    void updateVisibility();
+
+    // Bytes held by the mesh: the vertices kept on the CPU, and the chunk's range of the arena.
+    size_t getMeshMemoryUsage() const;
+    size_t getGpuMemoryUsage() const { return rangeCount * sizeof(Vertex); }
+
+    // Bytes held by the chunk besides its mesh: the blocks and the edits.
+    size_t getBlockMemoryUsage() const;
+
+    // The last frame the world needed the chunk, see World::setMemoryBudget.
+    uint64_t getLastUsedFrame() const { return lastUsedFrame; }
+    void setLastUsedFrame(uint64_t frame) { lastUsedFrame = frame; }
+
+    static void setMeshingMode(MeshingMode mode) { meshingMode = mode; }
+    static MeshingMode getMeshingMode() { return meshingMode; }
+
+    static void setCullingKernel(CullingKernel kernel) { cullingKernel = kernel; }
+    static CullingKernel getCullingKernel() { return cullingKernel; }
+
+    // Off leaves every corner unoccluded, to compare against. On by default.
+    static void setAmbientOcclusion(bool enabled) { ambientOcclusion = enabled; }
+    static bool getAmbientOcclusion() { return ambientOcclusion; }
+
+    // Index buffer shared by every chunk, built on first use.
+    static GLuint getQuadIndexBuffer();
+    static void destroyQuadIndexBuffer();
+
+    // Blocks are palette compressed (see BlockStorage), so they are read and written by value.
+    // Setting a block counts as an edit, see getEditedBlocks.
+    void setBlock(int x, int y, int z, Block::BlockType type);
+
+    /*
+     * Indices (as used by setBlock) of the blocks set since the chunk was generated, sorted. Generation is
+     * deterministic, so only these are saved and the rest of the chunk is generated again on load.
+     */
+    const std::vector<uint16_t> &getEditedBlocks() const { return editedBlocks; }
+    void setEditedBlocks(std::vector<uint16_t> &&edited) { editedBlocks = std::move(edited); }
+
+    // Set by edits the world hasn't saved yet.
+    bool hasUnsavedChanges() const { return unsavedChanges; }
+    void setUnsavedChanges(bool unsaved) { unsavedChanges = unsaved; }
 
     /* Gettets */
-    Block &getBlock(int x, int y, int z) {
-        int index = x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE);
-        return blocks[index];
+    Block getBlock(int x, int y, int z) const {
+        return Block(blocks.get(x + (y * CHUNK_SIZE) + (z * CHUNK_SIZE * CHUNK_SIZE)));
     }
 
     bool isBlockAtPosition(int x, int y, int z) {
         if (x < 0 || y < 0 || z < 0 || x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE) return false;
         return getBlock(x, y, z).type == Block::AIR;
     }
-    Vec3i getChunkPos() { return chunkPosition; }
+    Vec3i getChunkPos() const { return chunkPosition; }
+    const std::vector<Vertex> &getVertices(int section) const { return sections[section].vertices; }
+    // Vertices over all the sections, 0 when there is nothing to draw.
+    size_t getVertexCount() const;
+    const BlockStorage &getBlockStorage() const { return blocks; }
 private:
-    GLuint vbo;
-    GLuint vao;
+    // Where a section lives in the arena. Sections keep some room to grow so most edits fit in place.
+    struct MeshSection {
+        std::vector<Vertex> vertices;
+        uint32_t version = 0;
+        GLint firstVertex = 0;
+        GLsizei capacity = 0;
+    };
+
+    VertexArena *arena;
+    uint32_t slot; // VertexArena::NO_SLOT when the arena had none left.
+    GLint rangeFirst = 0; // The chunk's range of the arena, holding its sections then its bounding box.
+    GLsizei rangeCount = 0;
 
-    std::vector<Vertex> vertices {};
-    std::vector<Block> blocks {CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE, Block()};
+    std::array<MeshSection, SECTION_COUNT> sections {};
+    BlockStorage blocks {CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE};
 
     Vec3i chunkPosition;
+    uint32_t dirtySections = ALL_SECTIONS;
+    uint32_t meshVersion = 0; // Taken from lastMeshVersion, 0 is never handed out.
+    int lodLevel = 0;
+    std::vector<uint16_t> editedBlocks;
+    bool unsavedChanges = false;
+
+    uint64_t visibility = ~0ull; // Everything sees everything until it is worked out.
+    bool visibilityStale = true;
+
+    GLint boxFirstVertex = 0; // See BOX_VERTICES.
+
+    GLuint occlusionQuery = 0; // Made on first use.
+    bool occlusionQueryPending = false;
+    bool occluded = false; // As of the last query result.
+    uint64_t occlusionFrame = 0; // Last frame collectOcclusionQuery was called in.
+    bool meshDropped = false;
+    uint64_t lastUsedFrame = 0;
+
+    // Moves to a new range with room for the sections to grow and uploads all of them, and the bounding box after.
+    void reallocateSections();
+    void releaseRange();
+
+    void setOrigin();
+
+    void deleteOcclusionQuery();
+
+    static MeshingMode meshingMode;
+    static CullingKernel cullingKernel;
+    static bool ambientOcclusion;
+    static GLuint quadIndexBuffer;
+
+    /*
+     * Versions count up across every chunk, not per chunk, so a chunk recreated (or reset) at a place never reuses a
+     * version a result still in a worker or the upload queue carries. Only changed on the render thread.
+     */
+    static uint32_t lastMeshVersion;
 };
 
 #endif
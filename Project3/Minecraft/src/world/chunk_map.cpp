@@ -0,0 +1,80 @@
+#include "chunk_map.hpp"
+
+Chunk &ChunkMap::insert(std::unique_ptr<Chunk> chunk) {
+    if ((count + 1) * 2 > slots.size()) grow();
+
+    Vec3i pos = chunk->getChunkPos();
+    uint64_t key = packKey(pos[0], pos[1], pos[2]);
+    size_t mask = slots.size() - 1;
+    size_t index = hash(key) & mask;
+    while (slots[index].chunk != nullptr) index = (index + 1) & mask;
+
+    slots[index].key = key;
+    slots[index].chunk = std::move(chunk);
+    count++;
+    return *slots[index].chunk;
+}
+
+std::unique_ptr<Chunk> ChunkMap::extract(int x, int y, int z) {
+    if (slots.empty()) return nullptr;
+
+    uint64_t key = packKey(x, y, z);
+    size_t mask = slots.size() - 1;
+    size_t index = hash(key) & mask;
+    while (slots[index].chunk != nullptr && slots[index].key != key) index = (index + 1) & mask;
+    if (slots[index].chunk == nullptr) return nullptr;
+
+    if (lastChunk == slots[index].chunk.get()) lastChunk = nullptr;
+    std::unique_ptr<Chunk> chunk = std::move(slots[index].chunk);
+    count--;
+
+    /*
+     * No tombstones: the entries after the hole move back into it unless their home slot lies between the hole
+     * and where they are now (cyclically), in which case moving them would put them before their home.
+     */
+    size_t hole = index;
+    for (size_t next = (hole + 1) & mask; slots[next].chunk != nullptr; next = (next + 1) & mask) {
+        size_t home = hash(slots[next].key) & mask;
+        bool homeInRange = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (homeInRange) continue;
+
+        slots[hole] = std::move(slots[next]);
+        hole = next;
+    }
+    return chunk;
+}
+
+void ChunkMap::clear() {
+    slots.clear();
+    count = 0;
+    lastChunk = nullptr;
+}
+
+Chunk *ChunkMap::findSlow(uint64_t key) const {
+    if (slots.empty()) return nullptr;
+
+    size_t mask = slots.size() - 1;
+    for (size_t index = hash(key) & mask; slots[index].chunk != nullptr; index = (index + 1) & mask) {
+        if (slots[index].key == key) {
+            lastKey = key;
+            lastChunk = slots[index].chunk.get();
+            return lastChunk;
+        }
+    }
+    return nullptr;
+}
+
+void ChunkMap::grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots = std::vector<Slot>(old.empty() ? 64 : old.size() * 2);
+
+    // The chunks themselves don't move, so the last hit stays valid.
+    size_t mask = slots.size() - 1;
+    for (Slot &slot : old) {
+        if (slot.chunk == nullptr) continue;
+
+        size_t index = hash(slot.key) & mask;
+        while (slots[index].chunk != nullptr) index = (index + 1) & mask;
+        slots[index] = std::move(slot);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef CHUNK_MAP_HPP
+#define CHUNK_MAP_HPP
+
+#include "chunk.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+ * The loaded chunks, keyed by their chunk coordinates packed into one integer. Open addressing with linear probing
+ * in a power of two table kept at most half full, so a lookup is a hash and usually one or two slot reads, and
+ * never allocates. The last chunk found is remembered, since lookups come in runs for the same chunk (ray casts,
+ * edits, neighbour gathering). Chunks are heap allocated so pointers to them stay valid when the table grows.
+ */
+class ChunkMap {
+public:
+    // 21 bits per axis, enough for a million chunks either way from the origin.
+    static uint64_t packKey(int x, int y, int z) {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (uint64_t(uint32_t(x)) & mask) | ((uint64_t(uint32_t(y)) & mask) << 21) | ((uint64_t(uint32_t(z)) & mask) << 42);
+    }
+
+    Chunk *find(int x, int y, int z) const {
+        uint64_t key = packKey(x, y, z);
+        if (lastChunk != nullptr && lastKey == key) return lastChunk;
+        return findSlow(key);
+    }
+
+    // Adds a chunk under its own position, which must not be taken yet.
+    Chunk &insert(std::unique_ptr<Chunk> chunk);
+
+    // Takes the chunk out of the map and hands it back, nullptr when there is none.
+    std::unique_ptr<Chunk> extract(int x, int y, int z);
+
+    void clear();
+    size_t size() const { return count; }
+
+    struct Slot {
+        uint64_t key = 0;
+        std::unique_ptr<Chunk> chunk; // nullptr when the slot is empty.
+    };
+
+    // Visits the loaded chunks in table order. The map must not change while iterating.
+    class Iterator {
+    public:
+        Iterator(const std::vector<Slot> *slots, size_t index) : slots(slots), index(index) { skipEmpty(); }
+
+        Chunk &operator*() const { return *(*slots)[index].chunk; }
+        Iterator &operator++() { index++; skipEmpty(); return *this; }
+        bool operator!=(const Iterator &other) const { return index != other.index; }
+
+    private:
+        const std::vector<Slot> *slots;
+        size_t index;
+
+        void skipEmpty() {
+            while (index < slots->size() && (*slots)[index].chunk == nullptr) index++;
+        }
+    };
+
+    Iterator begin() const { return Iterator(&slots, 0); }
+    Iterator end() const { return Iterator(&slots, slots.size()); }
+
+private:
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    mutable uint64_t lastKey = 0;
+    mutable Chunk *lastChunk = nullptr;
+
+    static size_t hash(uint64_t key) {
+        // splitmix64 finaliser, neighbouring chunks land far apart.
+        key ^= key >> 30;
+        key *= 0xBF58476D1CE4E5B9ull;
+        key ^= key >> 27;
+        key *= 0x94D049BB133111EBull;
+        key ^= key >> 31;
+        return static_cast<size_t>(key);
+    }
+
+    Chunk *findSlow(uint64_t key) const;
+    void grow();
+};
+
+#endif
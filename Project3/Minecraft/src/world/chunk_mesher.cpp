@@ -0,0 +1,535 @@
+#include "chunk_mesher.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHUNK_MESHER_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    // Corner offsets for each face, drawn as the triangles (0, 1, 2) and (2, 1, 3) through the quad index buffer.
+    const int faceVertices[6][4][3] = {
+        // -Z (back)
+        {{0,0,0}, {1,0,0}, {0,1,0}, {1,1,0}},
+        // +Z (front)
+        {{0,0,1}, {0,1,1}, {1,0,1}, {1,1,1}},
+
+        // -Y (bottom)
+        {{0,0,0}, {0,0,1}, {1,0,0}, {1,0,1}},
+        // +Y (top)
+        {{0,1,0}, {1,1,0}, {0,1,1}, {1,1,1}},
+
+        // -X (left)
+        {{0,0,0}, {0,1,0}, {0,0,1}, {0,1,1}},
+        // +X (right)
+        {{1,0,0}, {1,0,1}, {1,1,0}, {1,1,1}},
+    };
+
+    // In hundredths, to fit the packed vertex.
+    const int faceBrightness[6] = {
+        30, // -Z (back) — much darker
+        100, // +Z (front) — unchanged
+        20, // -Y (bottom) — very dark
+        120, // +Y (top) — unchanged
+        40, // -X (left) — darker
+        85 // +X (right) — slightly darker
+    };
+
+    constexpr int COLUMN_COUNT = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+
+    inline int countTrailingZeros(uint32_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    // The atlas tile of every side of every block type, looked up once instead of per quad.
+    struct TileTable {
+        int tiles[Block::NUM_BLOCKS][6] = {};
+
+        TileTable() {
+            for (const auto &entry : Block::blockTextureCoords)
+                for (int face = 0; face < 6; face++)
+                    tiles[entry.first][face] = Block::getTileIndex(entry.second[face]);
+        }
+    };
+
+    const TileTable &tileTable() {
+        static const TileTable table;
+        return table;
+    }
+
+    // Bit of each of the 8 blocks around a face in the ring mask, indexed by (du + 1) + (dv + 1) * 3.
+    const int ringBit[9] = { 0, 1, 2, 3, -1, 4, 5, 6, 7 };
+
+    /*
+     * Each corner of a face is shaded by the three blocks touching it in the layer the face looks into: the two
+     * along the face's edges and the one on the diagonal. Two solid edge blocks fully occlude the corner no
+     * matter what the diagonal is. The result for every possible ring of 8 blocks is worked out once, packed
+     * as 2 bits per corner in faceVertices order.
+     */
+    struct AmbientOcclusionTable {
+        uint8_t corners[6][256] = {};
+
+        // Which solid columns run along each face's u axis, and their strides along its normal and v axes.
+        int uColumns[6] = {};
+        int normalStride[6] = {};
+        int vStride[6] = {};
+
+        AmbientOcclusionTable() {
+            for (int face = 0; face < 6; face++) {
+                const ChunkMesher::FaceAxes &axes = ChunkMesher::faceAxes[face];
+
+                for (int pair = 0; pair < 3; pair++) {
+                    const ChunkMesher::FaceAxes &columnAxes = ChunkMesher::faceAxes[pair * 2];
+                    if (columnAxes.normal != axes.u) continue;
+
+                    uColumns[face] = pair;
+                    normalStride[face] = columnAxes.u == axes.normal ? 1 : Chunk::PADDED_SIZE;
+                    vStride[face] = columnAxes.u == axes.v ? 1 : Chunk::PADDED_SIZE;
+                }
+
+                for (int ring = 0; ring < 256; ring++) {
+                    auto solid = [&](int du, int dv) { return (ring >> ringBit[(du + 1) + (dv + 1) * 3]) & 1; };
+
+                    for (int i = 0; i < 4; i++) {
+                        int du = faceVertices[face][i][axes.u] ? 1 : -1;
+                        int dv = faceVertices[face][i][axes.v] ? 1 : -1;
+
+                        int side1 = solid(du, 0);
+                        int side2 = solid(0, dv);
+                        int occlusion = (side1 && side2) ? 3 : side1 + side2 + solid(du, dv);
+                        corners[face][ring] |= static_cast<uint8_t>(occlusion << (i * 2));
+                    }
+                }
+            }
+        }
+    };
+
+    const AmbientOcclusionTable &ambientOcclusionTable() {
+        static const AmbientOcclusionTable table;
+        return table;
+    }
+
+    // Greedy mask entries: the block type in the low byte and the packed corner occlusion above it.
+    inline uint32_t packFaceKey(Block::BlockType type, uint32_t ao) {
+        return static_cast<uint32_t>(type) | (ao << 8);
+    }
+
+    inline Block::BlockType unpackFaceKey(uint32_t key, uint32_t &ao) {
+        ao = key >> 8;
+        return static_cast<Block::BlockType>(key & 0xFF);
+    }
+
+    // Only faces with the same occlusion on every corner can grow into bigger quads.
+    inline bool isFaceKeyMergeable(uint32_t key) {
+        uint32_t ao = key >> 8;
+        return ao == 0 || ao == 0x55 || ao == 0xAA || ao == 0xFF;
+    }
+
+    // The slice bits of the layers in a section.
+    inline uint32_t sectionSlices(int section) {
+        return ((1u << Chunk::SECTION_HEIGHT) - 1) << (section * Chunk::SECTION_HEIGHT);
+    }
+
+    inline int countBits(uint32_t value) {
+#ifdef _MSC_VER
+        return static_cast<int>(__popcnt(value));
+#else
+        return __builtin_popcount(value);
+#endif
+    }
+
+    // Turns a column of occupancy bits (padding included) into the bits of the faces that are exposed.
+    inline uint32_t exposedFaces(uint32_t solid, int direction) {
+        uint32_t exposed = direction < 0 ? solid & ~(solid << 1) : solid & ~(solid >> 1);
+        return (exposed >> 1) & 0xFFFF; // Drop the padding, bit 0 is now slice 0.
+    }
+}
+
+const ChunkMesher::FaceAxes ChunkMesher::faceAxes[6] = {
+    {2, 0, 1, -1}, // -Z (back)
+    {2, 0, 1, 1},  // +Z (front)
+    {1, 0, 2, -1}, // -Y (bottom)
+    {1, 0, 2, 1},  // +Y (top)
+    {0, 2, 1, -1}, // -X (left)
+    {0, 2, 1, 1},  // +X (right)
+};
+
+Chunk::SectionMeshes ChunkMesher::buildMesh(const Chunk::PaddedBlocks &padded, Chunk::MeshingMode mode, Chunk::CullingKernel kernel, bool ambientOcclusion, uint32_t sectionMask, int scale) {
+    // Occupancy bits are needed for ambient occlusion whichever kernel culls the faces.
+    SolidColumns solid;
+    buildSolidColumns(padded, solid);
+
+    // Culling the whole chunk is cheap next to meshing, the faces outside the sections are dropped afterwards.
+    VisibleFaces visible;
+    if (kernel == Chunk::CullingKernel::BITMASK)
+        cullFacesBitmask(solid, visible);
+    else
+        cullFacesPerBlock(padded, visible);
+
+    if (sectionMask != Chunk::ALL_SECTIONS)
+        clipToSections(visible, sectionMask);
+    if (scale > 1)
+        clipToCells(visible, Chunk::CHUNK_SIZE / scale);
+
+    // Reserve room for one quad per visible face, the most either mesher can emit.
+    size_t faceCounts[Chunk::SECTION_COUNT] = {};
+    for (int face = 0; face < 6; face++) {
+        for (int column = 0; column < COLUMN_COUNT; column++) {
+            uint32_t bits = visible.columns[face][column];
+            if (faceAxes[face].normal == 1) {
+                for (int section = 0; section < Chunk::SECTION_COUNT; section++)
+                    faceCounts[section] += countBits(bits & sectionSlices(section));
+            } else {
+                faceCounts[column / Chunk::CHUNK_SIZE / Chunk::SECTION_HEIGHT] += countBits(bits);
+            }
+        }
+    }
+
+    Chunk::SectionMeshes meshes;
+    for (int section = 0; section < Chunk::SECTION_COUNT; section++)
+        meshes[section].reserve(mode == Chunk::MeshingMode::GREEDY ? faceCounts[section] : faceCounts[section] * 4);
+
+    if (mode == Chunk::MeshingMode::GREEDY)
+        buildGreedyMesh(padded, solid, ambientOcclusion, visible, meshes);
+    else
+        buildNaiveMesh(padded, solid, ambientOcclusion, visible, meshes);
+
+    // Cells to blocks, the packed positions have room up to 31.
+    if (scale > 1) {
+        for (std::vector<Chunk::Vertex> &vertices : meshes) {
+            for (Chunk::Vertex &vertex : vertices) {
+                uint32_t position = (vertex.x() * scale) | ((vertex.y() * scale) << 5) | ((vertex.z() * scale) << 10);
+                vertex.data = (vertex.data & ~0x7FFFu) | position;
+            }
+        }
+    }
+
+    return meshes;
+}
+
+void ChunkMesher::clipToSections(VisibleFaces &visible, uint32_t sectionMask) {
+    uint32_t keptSlices = 0;
+    for (int section = 0; section < Chunk::SECTION_COUNT; section++)
+        if (sectionMask & (1u << section)) keptSlices |= sectionSlices(section);
+
+    for (int face = 0; face < 6; face++) {
+        // The top and bottom faces have y as their slice axis, the sides all have it as v (see faceAxes).
+        bool yIsSlice = faceAxes[face].normal == 1;
+
+        for (int column = 0; column < COLUMN_COUNT; column++) {
+            if (yIsSlice)
+                visible.columns[face][column] &= keptSlices;
+            else if (!((keptSlices >> (column / Chunk::CHUNK_SIZE)) & 1))
+                visible.columns[face][column] = 0;
+        }
+    }
+}
+
+void ChunkMesher::clipToCells(VisibleFaces &visible, int cells) {
+    const uint32_t keptSlices = (1u << cells) - 1;
+
+    for (int face = 0; face < 6; face++) {
+        for (int v = 0; v < Chunk::CHUNK_SIZE; v++) {
+            for (int u = 0; u < Chunk::CHUNK_SIZE; u++) {
+                uint16_t &bits = visible.columns[face][u + v * Chunk::CHUNK_SIZE];
+                bits = (u < cells && v < cells) ? static_cast<uint16_t>(bits & keptSlices) : 0;
+            }
+        }
+    }
+}
+
+void ChunkMesher::cullFacesPerBlock(const Chunk::PaddedBlocks &padded, VisibleFaces &visible) {
+    auto isFaceVisible = [&](int x, int y, int z) {
+        return padded[paddedIndex(x, y, z)] == Block::AIR;
+    };
+
+    for (int face = 0; face < 6; face++) {
+        const FaceAxes &axes = faceAxes[face];
+
+        for (int v = 0; v < Chunk::CHUNK_SIZE; v++) {
+            for (int u = 0; u < Chunk::CHUNK_SIZE; u++) {
+                uint16_t bits = 0;
+
+                for (int slice = 0; slice < Chunk::CHUNK_SIZE; slice++) {
+                    int pos[3];
+                    pos[axes.normal] = slice;
+                    pos[axes.u] = u;
+                    pos[axes.v] = v;
+                    if (padded[paddedIndex(pos[0], pos[1], pos[2])] == Block::AIR)
+                        continue;
+
+                    // Check the neighbour the face points at.
+                    pos[axes.normal] += axes.direction;
+                    if (isFaceVisible(pos[0], pos[1], pos[2]))
+                        bits |= static_cast<uint16_t>(1 << slice);
+                }
+
+                visible.columns[face][u + v * Chunk::CHUNK_SIZE] = bits;
+            }
+        }
+    }
+}
+
+void ChunkMesher::buildSolidColumns(const Chunk::PaddedBlocks &padded, SolidColumns &solid) {
+    std::memset(&solid, 0, sizeof(solid));
+
+    // One pass over the padded blocks fills the columns of all three axes.
+    int index = 0;
+    for (int z = 0; z < Chunk::PADDED_SIZE; z++) {
+        for (int y = 0; y < Chunk::PADDED_SIZE; y++) {
+            for (int x = 0; x < Chunk::PADDED_SIZE; x++, index++) {
+                uint32_t isSolid = padded[index] != Block::AIR ? 1u : 0u;
+
+                // Indexed by the u and v axes of the faces along each column (see faceAxes).
+                solid.columns[0][x + y * Chunk::PADDED_SIZE] |= isSolid << z;
+                solid.columns[1][x + z * Chunk::PADDED_SIZE] |= isSolid << y;
+                solid.columns[2][z + y * Chunk::PADDED_SIZE] |= isSolid << x;
+            }
+        }
+    }
+}
+
+void ChunkMesher::cullFacesBitmask(const SolidColumns &solid, VisibleFaces &visible) {
+    /*
+     * Every column of the chunk along an axis is an 18 bit occupancy mask (the padding at bit 0 and 17), so a
+     * face is exposed where a solid bit has an empty bit next to it: solid & ~(solid << 1) for the faces pointing
+     * down the axis and solid & ~(solid >> 1) for the ones pointing up it. Both faces of an axis share the columns.
+     */
+#ifdef CHUNK_MESHER_SSE2
+    // SSE2 only packs to signed 16 bits, so the masks are biased around the pack.
+    const __m128i paddingMask = _mm_set1_epi32(0xFFFF);
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    auto exposedFaces4 = [&](__m128i bits, bool up) {
+        __m128i exposed = _mm_andnot_si128(up ? _mm_srli_epi32(bits, 1) : _mm_slli_epi32(bits, 1), bits);
+        return _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(exposed, 1), paddingMask), bias32);
+    };
+#endif
+
+    for (int face = 0; face < 6; face += 2) {
+        for (int v = 0; v < Chunk::CHUNK_SIZE; v++) {
+            // One row of columns inside the chunk, skipping the padding on either side.
+            const uint32_t *columns = solid.columns[face / 2] + 1 + (v + 1) * Chunk::PADDED_SIZE;
+            uint16_t *down = visible.columns[face] + v * Chunk::CHUNK_SIZE;
+            uint16_t *up = visible.columns[face + 1] + v * Chunk::CHUNK_SIZE;
+
+            int column = 0;
+#ifdef CHUNK_MESHER_SSE2
+            // Eight columns at a time.
+            for (; column + 8 <= Chunk::CHUNK_SIZE; column += 8) {
+                __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + column));
+                __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + column + 4));
+
+                __m128i downFaces = _mm_add_epi16(_mm_packs_epi32(exposedFaces4(low, false), exposedFaces4(high, false)), bias16);
+                __m128i upFaces = _mm_add_epi16(_mm_packs_epi32(exposedFaces4(low, true), exposedFaces4(high, true)), bias16);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(down + column), downFaces);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(up + column), upFaces);
+            }
+#endif
+            for (; column < Chunk::CHUNK_SIZE; column++) {
+                down[column] = static_cast<uint16_t>(exposedFaces(columns[column], -1));
+                up[column] = static_cast<uint16_t>(exposedFaces(columns[column], 1));
+            }
+        }
+    }
+}
+
+void ChunkMesher::buildNaiveMesh(const Chunk::PaddedBlocks &padded, const SolidColumns &solid, bool ambientOcclusion, const VisibleFaces &visible, Chunk::SectionMeshes &meshes) {
+    // One quad per set bit.
+    for (int face = 0; face < 6; face++) {
+        const FaceAxes &axes = faceAxes[face];
+
+        for (int column = 0; column < COLUMN_COUNT; column++) {
+            uint32_t bits = visible.columns[face][column];
+
+            while (bits != 0) {
+                int pos[3];
+                pos[axes.normal] = countTrailingZeros(bits);
+                pos[axes.u] = column % Chunk::CHUNK_SIZE;
+                pos[axes.v] = column / Chunk::CHUNK_SIZE;
+                bits &= bits - 1;
+
+                uint32_t ao = ambientOcclusion ? computeAmbientOcclusion(solid, face, pos) : 0;
+                addQuad(meshes[pos[1] / Chunk::SECTION_HEIGHT], pos[0], pos[1], pos[2], face, padded[paddedIndex(pos[0], pos[1], pos[2])], 1, 1, ao);
+            }
+        }
+    }
+}
+
+void ChunkMesher::buildGreedyMesh(const Chunk::PaddedBlocks &padded, const SolidColumns &solid, bool ambientOcclusion, const VisibleFaces &visible, Chunk::SectionMeshes &meshes) {
+    /*
+     * For every face direction, sweep the chunk one slice at a time. Each slice builds a 2D mask of the
+     * visible faces (by block type and corner occlusion), then grows rectangles out of it: first along u,
+     * then along v for as long as the whole row matches. Faces of the same direction share a brightness, so
+     * only the type and occlusion have to match. Faces with uneven occlusion are never merged, stretching
+     * their corners over a bigger quad would change the shading. Quads never grow across a section boundary,
+     * so every one of them belongs to the section it starts in.
+     */
+    uint32_t mask[COLUMN_COUNT];
+
+    for (int face = 0; face < 6; face++) {
+        const FaceAxes &axes = faceAxes[face];
+
+        // Slices without a single visible face can be skipped, and so can empty rows (when only some sections are meshed).
+        uint32_t occupiedSlices = 0;
+        int firstRow = Chunk::CHUNK_SIZE;
+        int endRow = 0;
+        for (int v = 0; v < Chunk::CHUNK_SIZE; v++) {
+            uint32_t rowSlices = 0;
+            for (int u = 0; u < Chunk::CHUNK_SIZE; u++)
+                rowSlices |= visible.columns[face][u + v * Chunk::CHUNK_SIZE];
+
+            if (rowSlices == 0) continue;
+            occupiedSlices |= rowSlices;
+            firstRow = std::min(firstRow, v);
+            endRow = v + 1;
+        }
+
+        while (occupiedSlices != 0) {
+            int slice = countTrailingZeros(occupiedSlices);
+            occupiedSlices &= occupiedSlices - 1;
+
+            // Build the mask of visible faces in this slice, 0 where there is none.
+            for (int v = firstRow; v < endRow; v++) {
+                for (int u = 0; u < Chunk::CHUNK_SIZE; u++) {
+                    uint32_t key = 0;
+                    if ((visible.columns[face][u + v * Chunk::CHUNK_SIZE] >> slice) & 1) {
+                        int pos[3];
+                        pos[axes.normal] = slice;
+                        pos[axes.u] = u;
+                        pos[axes.v] = v;
+
+                        key = packFaceKey(padded[paddedIndex(pos[0], pos[1], pos[2])], ambientOcclusion ? computeAmbientOcclusion(solid, face, pos) : 0);
+                    }
+                    mask[u + v * Chunk::CHUNK_SIZE] = key;
+                }
+            }
+
+            // Merge the mask into rectangles.
+            for (int v = firstRow; v < endRow; v++) {
+                for (int u = 0; u < Chunk::CHUNK_SIZE;) {
+                    uint32_t key = mask[u + v * Chunk::CHUNK_SIZE];
+                    if (key == 0) {
+                        u++;
+                        continue;
+                    }
+
+                    int width = 1;
+                    int height = 1;
+                    if (isFaceKeyMergeable(key)) {
+                        while (u + width < Chunk::CHUNK_SIZE && mask[u + width + v * Chunk::CHUNK_SIZE] == key)
+                            width++;
+
+                        for (; v + height < endRow; height++) {
+                            if (axes.v == 1 && (v + height) % Chunk::SECTION_HEIGHT == 0) break;
+                            bool rowMatches = true;
+                            for (int k = 0; k < width; k++) {
+                                if (mask[u + k + (v + height) * Chunk::CHUNK_SIZE] != key) {
+                                    rowMatches = false;
+                                    break;
+                                }
+                            }
+                            if (!rowMatches) break;
+                        }
+                    }
+
+                    // Clear the merged faces so they aren't emitted twice.
+                    for (int j = 0; j < height; j++)
+                        for (int k = 0; k < width; k++)
+                            mask[u + k + (v + j) * Chunk::CHUNK_SIZE] = 0;
+
+                    uint32_t ao;
+                    Block::BlockType type = unpackFaceKey(key, ao);
+
+                    int pos[3];
+                    pos[axes.normal] = slice;
+                    pos[axes.u] = u;
+                    pos[axes.v] = v;
+                    addQuad(meshes[pos[1] / Chunk::SECTION_HEIGHT], pos[0], pos[1], pos[2], face, type, width, height, ao);
+
+                    u += width;
+                }
+            }
+        }
+    }
+}
+
+uint32_t ChunkMesher::computeAmbientOcclusion(const SolidColumns &solid, int face, const int pos[3]) {
+    const AmbientOcclusionTable &table = ambientOcclusionTable();
+    const FaceAxes &axes = faceAxes[face];
+
+    /*
+     * The 8 blocks around the face in the layer it looks into are three bits in each of three columns running
+     * along the face's u axis, one column per row of v. Padded coordinates are one more than chunk coordinates,
+     * so the bits of u - 1 to u + 1 start at bit u.
+     */
+    const uint32_t *columns = solid.columns[table.uColumns[face]];
+    const int layer = (pos[axes.normal] + axes.direction + 1) * table.normalStride[face];
+    const int row = layer + (pos[axes.v] + 1) * table.vStride[face];
+    const int u = pos[axes.u];
+
+    uint32_t below = columns[row - table.vStride[face]] >> u;
+    uint32_t middle = columns[row] >> u;
+    uint32_t above = columns[row + table.vStride[face]] >> u;
+    unsigned int ring = (below & 7) | ((middle & 1) << 3) | (((middle >> 2) & 1) << 4) | ((above & 7) << 5);
+
+    return table.corners[face][ring];
+}
+
+std::vector<Chunk::Vertex> ChunkMesher::buildBoundingBox() {
+    const int size = Chunk::CHUNK_SIZE;
+
+    // A face of the whole chunk is a quad of its outermost layer of blocks.
+    std::vector<Chunk::Vertex> vertices;
+    for (int face = 0; face < 6; face++) {
+        int position[3] = { 0, 0, 0 };
+        if (faceAxes[face].direction > 0) position[faceAxes[face].normal] = size - 1;
+        addQuad(vertices, position[0], position[1], position[2], face, Block::STONE, size, size, 0);
+    }
+    return vertices;
+}
+
+void ChunkMesher::addQuad(std::vector<Chunk::Vertex> &vertices, int x, int y, int z, int face, Block::BlockType type, int width, int height, uint32_t ao) {
+    // Get the atlas tile for this side of the block type
+    int tile = tileTable().tiles[type][face];
+
+    // Size of the quad along each axis, the normal axis always stays one block thick.
+    int size[3];
+    size[faceAxes[face].normal] = 1;
+    size[faceAxes[face].u] = width;
+    size[faceAxes[face].v] = height;
+
+    /*
+     * The index buffer splits every quad along the 1-2 diagonal. When corners 0 and 3 are darker the quad is
+     * rotated so the split runs through them instead, otherwise the occlusion gets interpolated unevenly and
+     * the shading depends on which way the quad happens to face.
+     */
+    static const int orders[2][4] = { { 0, 1, 2, 3 }, { 1, 3, 0, 2 } };
+    const int *order = orders[(ao & 3) + (ao >> 6) > ((ao >> 2) & 3) + ((ao >> 4) & 3)];
+
+    for (int n = 0; n < 4; n++) {
+        int i = order[n];
+
+        // Chunk-local position, the shader adds the chunk origin.
+        int vx = x + faceVertices[face][i][0] * size[0];
+        int vy = y + faceVertices[face][i][1] * size[1];
+        int vz = z + faceVertices[face][i][2] * size[2];
+
+        vertices.push_back(Chunk::Vertex::pack(vx, vy, vz, face, (ao >> (i * 2)) & 3, tile, faceBrightness[face]));
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef CHUNK_MESHER_HPP
+#define CHUNK_MESHER_HPP
+
+#include "chunk.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+/*
+ * The CPU half of chunk meshing. It only reads a padded snapshot of the blocks (see Chunk::buildPaddedBlocks),
+ * never the chunk itself, so it is safe to run on a worker thread while the chunk keeps being edited.
+ */
+class ChunkMesher {
+public:
+    // The axis each face points along, and the axes its texture u and v run along.
+    struct FaceAxes {
+        int normal, u, v, direction;
+    };
+
+    static const FaceAxes faceAxes[6];
+
+    // Index into the padded grid, which runs from -1 to CHUNK_SIZE on every axis.
+    static int paddedIndex(int x, int y, int z) {
+        return (x + 1) + (y + 1) * Chunk::PADDED_SIZE + (z + 1) * Chunk::PADDED_SIZE * Chunk::PADDED_SIZE;
+    }
+
+    /*
+     * Meshes the sections in `sectionMask` (see Chunk::SECTION_HEIGHT), the other meshes are left empty. With a
+     * scale above 1 the blocks are downsampled cells (see Chunk::buildDownsampledBlocks) and sections are
+     * counted in cells, so the whole chunk has to be meshed.
+     */
+    static Chunk::SectionMeshes buildMesh(const Chunk::PaddedBlocks &padded, Chunk::MeshingMode mode, Chunk::CullingKernel kernel, bool ambientOcclusion, uint32_t sectionMask, int scale);
+
+    // The chunk's bounding box as six quads facing out, Chunk::BOX_VERTICES vertices in all.
+    static std::vector<Chunk::Vertex> buildBoundingBox();
+
+private:
+    // Bit `slice` of columns[face][u + v * CHUNK_SIZE] is set when that block's face is exposed.
+    struct VisibleFaces {
+        uint16_t columns[6][Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE];
+    };
+
+    /*
+     * Occupancy of the padded blocks as 18 bit columns along each axis, bit (i + 1) for coordinate i. The columns
+     * along the normal of faces 2p and 2p + 1 are in columns[p], indexed (u + 1) + (v + 1) * PADDED_SIZE with the
+     * u and v axes of those faces.
+     */
+    struct SolidColumns {
+        uint32_t columns[3][Chunk::PADDED_SIZE * Chunk::PADDED_SIZE];
+    };
+
+    // Drops the faces of blocks outside the sections in `sectionMask`.
+    static void clipToSections(VisibleFaces &visible, uint32_t sectionMask);
+
+    // Drops the faces of cells at `cells` and beyond, where the border and the air past it sit when downsampled.
+    static void clipToCells(VisibleFaces &visible, int cells);
+
+    static void buildSolidColumns(const Chunk::PaddedBlocks &padded, SolidColumns &solid);
+
+    static void cullFacesPerBlock(const Chunk::PaddedBlocks &padded, VisibleFaces &visible);
+    static void cullFacesBitmask(const SolidColumns &solid, VisibleFaces &visible);
+
+    // Without ambient occlusion `solid` isn't read and every corner is left unoccluded.
+    static void buildNaiveMesh(const Chunk::PaddedBlocks &padded, const SolidColumns &solid, bool ambientOcclusion, const VisibleFaces &visible, Chunk::SectionMeshes &meshes);
+    static void buildGreedyMesh(const Chunk::PaddedBlocks &padded, const SolidColumns &solid, bool ambientOcclusion, const VisibleFaces &visible, Chunk::SectionMeshes &meshes);
+
+    // Occlusion (0 to 3 solid blocks) of each corner of the face of the block at `pos`, 2 bits a corner in
+    // faceVertices order.
+    static uint32_t computeAmbientOcclusion(const SolidColumns &solid, int face, const int pos[3]);
+
+    // Adds a quad for `face` starting at block (x, y, z), spanning width x height blocks along the face's u and v axes.
+    // `ao` is the corner occlusion as computeAmbientOcclusion packs it.
+    static void addQuad(std::vector<Chunk::Vertex> &vertices, int x, int y, int z, int face, Block::BlockType type, int width, int height, uint32_t ao);
+};
+
+#endif
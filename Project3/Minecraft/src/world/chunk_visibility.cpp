@@ -0,0 +1,99 @@
+#include "chunk_visibility.hpp"
+#include "chunk_mesher.hpp"
+
+// std
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    constexpr int SIZE = Chunk::CHUNK_SIZE;
+
+    inline int countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+}
+
+constexpr ChunkVisibility::Graph ChunkVisibility::ALL_CONNECTED;
+
+ChunkVisibility::Graph ChunkVisibility::fromBlocks(const BlockStorage &blocks) {
+    if (blocks.isUniform()) return blocks.getUniformType() == Block::AIR ? ALL_CONNECTED : 0;
+
+    OpenBlocks open;
+    std::memset(open.words, 0, sizeof(open.words));
+    for (int index = 0; index < BLOCK_COUNT; index++) {
+        if (blocks.get(index) == Block::AIR) open.words[index / 64] |= 1ull << (index % 64);
+    }
+    return floodFill(open);
+}
+
+ChunkVisibility::Graph ChunkVisibility::fromPaddedBlocks(const Chunk::PaddedBlocks &padded) {
+    OpenBlocks open;
+    std::memset(open.words, 0, sizeof(open.words));
+    for (int z = 0; z < SIZE; z++) {
+        for (int y = 0; y < SIZE; y++) {
+            for (int x = 0; x < SIZE; x++) {
+                int index = x + y * SIZE + z * SIZE * SIZE;
+                if (padded[ChunkMesher::paddedIndex(x, y, z)] == Block::AIR) open.words[index / 64] |= 1ull << (index % 64);
+            }
+        }
+    }
+    return floodFill(open);
+}
+
+ChunkVisibility::Graph ChunkVisibility::floodFill(OpenBlocks &open) {
+    // Blocks are cleared from `open` as they are reached, so each one is visited once.
+    static const int strides[3] = { 1, SIZE, SIZE * SIZE };
+    uint16_t stack[BLOCK_COUNT];
+    Graph graph = 0;
+
+    for (int word = 0; word < BLOCK_COUNT / 64; word++) {
+        while (open.words[word] != 0) {
+            int seed = word * 64 + countTrailingZeros(open.words[word]);
+            open.words[word] &= open.words[word] - 1;
+
+            int top = 0;
+            stack[top++] = static_cast<uint16_t>(seed);
+            uint32_t faces = 0;
+
+            while (top > 0) {
+                int index = stack[--top];
+                int coords[3] = { index % SIZE, (index / SIZE) % SIZE, index / (SIZE * SIZE) };
+
+                // Axis 0 is x, whose faces are 4 and 5, y has 2 and 3, z has 0 and 1.
+                for (int axis = 0; axis < 3; axis++) {
+                    int lowFace = (2 - axis) * 2;
+                    for (int step = -1; step <= 1; step += 2) {
+                        int coord = coords[axis] + step;
+                        if (coord < 0 || coord >= SIZE) {
+                            faces |= 1u << (step < 0 ? lowFace : lowFace + 1);
+                            continue;
+                        }
+
+                        int next = index + step * strides[axis];
+                        uint64_t bit = 1ull << (next % 64);
+                        if (!(open.words[next / 64] & bit)) continue;
+
+                        open.words[next / 64] &= ~bit;
+                        stack[top++] = static_cast<uint16_t>(next);
+                    }
+                }
+            }
+
+            // Every face the pocket reaches sees every other one it reaches.
+            for (int face = 0; face < 6; face++) {
+                if (faces & (1u << face)) graph |= static_cast<Graph>(faces) << (face * 6);
+            }
+            if (graph == ALL_CONNECTED) return graph;
+        }
+    }
+    return graph;
+}
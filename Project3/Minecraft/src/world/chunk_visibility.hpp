@@ -0,0 +1,39 @@
+#ifndef CHUNK_VISIBILITY_HPP
+#define CHUNK_VISIBILITY_HPP
+
+#include "chunk.hpp"
+
+// std
+#include <cstdint>
+
+/*
+ * Which faces of a chunk can see each other through it, for cave culling. The air is flood filled one connected
+ * pocket at a time, and every pair of faces a pocket touches can see each other. Faces are numbered like the
+ * mesher's (see ChunkMesher::faceAxes): -Z, +Z, -Y, +Y, -X, +X, so face ^ 1 is the opposite one.
+ */
+class ChunkVisibility {
+public:
+    // Bit a * 6 + b is set when faces a and b see each other, a graph is always symmetric.
+    typedef uint64_t Graph;
+
+    static constexpr Graph ALL_CONNECTED = (1ull << 36) - 1;
+
+    static bool connects(Graph graph, int a, int b) { return (graph >> (a * 6 + b)) & 1; }
+
+    static Graph fromBlocks(const BlockStorage &blocks);
+
+    // Only the chunk itself is looked at, the padded blocks have to be at full detail.
+    static Graph fromPaddedBlocks(const Chunk::PaddedBlocks &padded);
+
+private:
+    static constexpr int BLOCK_COUNT = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+
+    // Bit i of open[i / 64] is set for air, indexed like Chunk::setBlock.
+    struct OpenBlocks {
+        uint64_t words[BLOCK_COUNT / 64];
+    };
+
+    static Graph floodFill(OpenBlocks &open);
+};
+
+#endif
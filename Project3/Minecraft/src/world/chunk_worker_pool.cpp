@@ -0,0 +1,113 @@
+#include "chunk_worker_pool.hpp"
+#include "chunk_mesher.hpp"
+#include "chunk_visibility.hpp"
+
+ChunkWorkerPool::ChunkWorkerPool(unsigned int threadCount) {
+    if (threadCount == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ChunkWorkerPool::workerLoop, this);
+    }
+}
+
+ChunkWorkerPool::~ChunkWorkerPool() {
+    stop();
+}
+
+void ChunkWorkerPool::submit(MeshJob &&job) {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        meshJobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ChunkWorkerPool::submit(TerrainJob &&job) {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        terrainJobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ChunkWorkerPool::collectFinished(std::vector<MeshResult> &finished) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    for (MeshResult &result : meshResults) {
+        finished.push_back(std::move(result));
+    }
+    meshResults.clear();
+}
+
+void ChunkWorkerPool::collectFinished(std::vector<TerrainResult> &finished) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    for (TerrainResult &result : terrainResults) {
+        finished.push_back(std::move(result));
+    }
+    terrainResults.clear();
+}
+
+void ChunkWorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (stopping) return;
+
+        stopping = true;
+        meshJobs.clear();
+        terrainJobs.clear();
+    }
+    jobAvailable.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ChunkWorkerPool::workerLoop() {
+    while (true) {
+        MeshJob meshJob;
+        TerrainJob terrainJob;
+        bool meshing;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobAvailable.wait(lock, [this] { return stopping || !meshJobs.empty() || !terrainJobs.empty(); });
+            if (stopping) return;
+
+            // Meshes go first, they are what makes an edit show up.
+            meshing = !meshJobs.empty();
+            if (meshing) {
+                meshJob = std::move(meshJobs.front());
+                meshJobs.pop_front();
+            } else {
+                terrainJob = std::move(terrainJobs.front());
+                terrainJobs.pop_front();
+            }
+        }
+
+        if (meshing) {
+            MeshResult result{ meshJob.chunkPosition, meshJob.version, meshJob.sections, ChunkMesher::buildMesh(meshJob.padded, meshJob.mode, meshJob.kernel, meshJob.ambientOcclusion, meshJob.sections, meshJob.scale), meshJob.scale == 1, 0 };
+            if (result.hasVisibility) result.visibility = ChunkVisibility::fromPaddedBlocks(meshJob.padded);
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            meshResults.push_back(std::move(result));
+        } else {
+            const Vec3i &pos = terrainJob.chunkPosition;
+            TerrainResult result{ pos, terrainJob.generator, terrainJob.generator->generate(pos), {}, 0 };
+
+            RegionStore::ChunkEdits edits;
+            if (terrainJob.regions != nullptr && terrainJob.regions->load(pos, edits)) {
+                for (const RegionStore::BlockEdit &edit : edits) {
+                    result.blocks.set(edit.index, edit.type);
+                    result.editedBlocks.push_back(edit.index);
+                }
+            }
+            result.visibility = ChunkVisibility::fromBlocks(result.blocks);
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            terrainResults.push_back(std::move(result));
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef CHUNK_WORKER_POOL_HPP
+#define CHUNK_WORKER_POOL_HPP
+
+#include "chunk.hpp"
+#include "region_store.hpp"
+#include "terrain_generator.hpp"
+
+// STD
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs the CPU side of chunks on a pool of worker threads: loading or generating the blocks of new chunks, and meshing.
+ * Jobs carry everything they need (a snapshot of the blocks, the generator), finished work queues up until the
+ * render thread collects it and does the GL side.
+ */
+class ChunkWorkerPool {
+public:
+    struct MeshJob {
+        Vec3i chunkPosition;
+        uint32_t version; // From Chunk::beginRemesh, sections remeshed again since are not uploaded.
+        uint32_t sections; // Which sections of the chunk to mesh.
+        int scale; // Level of detail, see Chunk::lodScale.
+        Chunk::MeshingMode mode;
+        Chunk::CullingKernel kernel;
+        bool ambientOcclusion;
+        Chunk::PaddedBlocks padded;
+    };
+
+    struct MeshResult {
+        Vec3i chunkPosition;
+        uint32_t version;
+        uint32_t sections;
+        Chunk::SectionMeshes meshes;
+        bool hasVisibility; // Only full detail jobs work out the chunk's visibility, see ChunkVisibility.
+        uint64_t visibility;
+    };
+
+    // Chunks are generated, with their saved edits from the region store replayed over them.
+    struct TerrainJob {
+        Vec3i chunkPosition;
+        std::shared_ptr<const TerrainGenerator> generator;
+        std::shared_ptr<RegionStore> regions; // nullptr when the world isn't saved.
+    };
+
+    struct TerrainResult {
+        Vec3i chunkPosition;
+        std::shared_ptr<const TerrainGenerator> generator; // Lets results from a replaced generator be told apart.
+        BlockStorage blocks;
+        std::vector<uint16_t> editedBlocks; // See Chunk::getEditedBlocks.
+        uint64_t visibility; // See Chunk::getVisibility.
+    };
+
+    // A thread count of 0 uses one thread per core, minus one for the render thread.
+    explicit ChunkWorkerPool(unsigned int threadCount = 0);
+    ~ChunkWorkerPool();
+
+    void submit(MeshJob &&job);
+    void submit(TerrainJob &&job);
+
+    // Moves every finished mesh or chunk into `finished`.
+    void collectFinished(std::vector<MeshResult> &finished);
+    void collectFinished(std::vector<TerrainResult> &finished);
+
+    // Finishes the job each worker is on, drops the rest and joins the threads.
+    void stop();
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex jobMutex;
+    std::condition_variable jobAvailable;
+    std::deque<MeshJob> meshJobs;
+    std::deque<TerrainJob> terrainJobs;
+    bool stopping = false;
+
+    std::mutex resultMutex;
+    std::vector<MeshResult> meshResults;
+    std::vector<TerrainResult> terrainResults;
+
+    void workerLoop();
+};
+
+#endif
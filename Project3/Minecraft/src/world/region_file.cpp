@@ -0,0 +1,242 @@
+#include "region_file.hpp"
+
+// std
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // "RGN1", then the table. Everything is stored little endian.
+    const uint32_t REGION_MAGIC = 0x314E4752;
+    constexpr size_t TABLE_OFFSET = sizeof(uint32_t);
+    constexpr size_t HEADER_SIZE = TABLE_OFFSET + RegionFile::CHUNK_COUNT * 2 * sizeof(uint32_t);
+
+    // Offsets in the table are 32 bits, and so is the end of any payload.
+    constexpr size_t MAX_FILE_SIZE = std::numeric_limits<uint32_t>::max();
+}
+
+RegionFile::RegionFile(const std::string &path, bool create) : path(path) {
+    opened = openFile(create);
+}
+
+RegionFile::~RegionFile() {
+    closeFile();
+}
+
+bool RegionFile::read(int index, const std::function<bool(const uint8_t *data, size_t size)> &decode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened) return false;
+
+    const Entry &entry = table[index];
+    if (entry.size == 0) return false;
+
+    // Written since the file was last mapped.
+    if (entry.offset + entry.size > mappedSize && !map()) return false;
+
+    return decode(mapped + entry.offset, entry.size);
+}
+
+bool RegionFile::write(int index, const uint8_t *data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened) return false;
+
+    // Past the end of what the table can point at, the waste has to go first.
+    if (size > MAX_FILE_SIZE - fileSize && wastedBytes > 0 && !compactLocked()) return false;
+    if (size > MAX_FILE_SIZE - fileSize) {
+        std::cerr << "Region file full: " << path << std::endl;
+        return false;
+    }
+
+    Entry entry{ static_cast<uint32_t>(fileSize), static_cast<uint32_t>(size) };
+    if (!writeAt(fileSize, data, size)) return false;
+    if (!writeAt(TABLE_OFFSET + index * sizeof(Entry), &entry, sizeof(Entry))) return false;
+
+    wastedBytes += table[index].size;
+    table[index] = entry;
+    fileSize += size;
+    return true;
+}
+
+size_t RegionFile::getWastedBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return wastedBytes;
+}
+
+size_t RegionFile::getFileSize() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fileSize;
+}
+
+bool RegionFile::compact() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return compactLocked();
+}
+
+bool RegionFile::compactLocked() {
+    if (!opened || wastedBytes == 0) return true;
+    if (mappedSize < fileSize && !map()) return false;
+
+    // Build the new file next to the old one and swap it in, a crash part way leaves the old one intact.
+    std::vector<uint8_t> compacted(HEADER_SIZE);
+    std::array<Entry, CHUNK_COUNT> newTable {};
+    for (int index = 0; index < CHUNK_COUNT; index++) {
+        const Entry &entry = table[index];
+        if (entry.size == 0) continue;
+
+        newTable[index] = Entry{ static_cast<uint32_t>(compacted.size()), entry.size };
+        compacted.insert(compacted.end(), mapped + entry.offset, mapped + entry.offset + entry.size);
+    }
+    std::memcpy(compacted.data(), &REGION_MAGIC, sizeof(uint32_t));
+    std::memcpy(compacted.data() + TABLE_OFFSET, newTable.data(), sizeof(Entry) * CHUNK_COUNT);
+
+    std::string temporaryPath = path + ".tmp";
+    std::FILE *temporary = std::fopen(temporaryPath.c_str(), "wb");
+    if (temporary == nullptr) return false;
+    bool written = std::fwrite(compacted.data(), 1, compacted.size(), temporary) == compacted.size();
+    written = (std::fclose(temporary) == 0) && written;
+    if (!written) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    closeFile();
+#ifdef _WIN32
+    bool replaced = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool replaced = std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!replaced) std::cerr << "Failed to replace region file " << path << std::endl;
+
+    opened = openFile(false);
+    return replaced && opened;
+}
+
+bool RegionFile::openFile(bool create) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    file = handle;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    fileSize = static_cast<size_t>(size.QuadPart);
+#else
+    file = ::open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (file < 0) return false;
+
+    struct stat status;
+    fstat(file, &status);
+    fileSize = static_cast<size_t>(status.st_size);
+#endif
+
+    // A new file gets an empty table.
+    if (fileSize == 0) {
+        std::vector<uint8_t> header(HEADER_SIZE, 0);
+        std::memcpy(header.data(), &REGION_MAGIC, sizeof(uint32_t));
+        if (!writeAt(0, header.data(), header.size())) return false;
+        fileSize = HEADER_SIZE;
+    }
+
+    // Too short to hold the table, or too long for it to point into.
+    if (fileSize < HEADER_SIZE || fileSize > MAX_FILE_SIZE) {
+        std::cerr << "Not a region file: " << path << std::endl;
+        return false;
+    }
+    if (!map()) return false;
+
+    uint32_t magic;
+    std::memcpy(&magic, mapped, sizeof(uint32_t));
+    if (magic != REGION_MAGIC) {
+        std::cerr << "Not a region file: " << path << std::endl;
+        return false;
+    }
+
+    std::memcpy(table.data(), mapped + TABLE_OFFSET, sizeof(Entry) * CHUNK_COUNT);
+
+    // Anything not in the table is waste, entries pointing past the end are dropped.
+    size_t liveBytes = 0;
+    for (Entry &entry : table) {
+        if (static_cast<size_t>(entry.offset) + entry.size > fileSize || (entry.size != 0 && entry.offset < HEADER_SIZE)) entry = Entry{};
+        liveBytes += entry.size;
+    }
+    wastedBytes = fileSize - HEADER_SIZE - liveBytes;
+    return true;
+}
+
+void RegionFile::closeFile() {
+    unmap();
+#ifdef _WIN32
+    if (file != nullptr) CloseHandle(file);
+    file = nullptr;
+#else
+    if (file >= 0) ::close(file);
+    file = -1;
+#endif
+}
+
+bool RegionFile::writeAt(size_t offset, const void *data, size_t size) {
+#ifdef _WIN32
+    OVERLAPPED position = {};
+    position.Offset = static_cast<DWORD>(offset);
+    position.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+
+    DWORD written = 0;
+    return WriteFile(file, data, static_cast<DWORD>(size), &written, &position) && written == size;
+#else
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t written = ::pwrite(file, bytes, size, static_cast<off_t>(offset));
+        if (written <= 0) return false;
+
+        bytes += written;
+        offset += static_cast<size_t>(written);
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+#endif
+}
+
+bool RegionFile::map() {
+    unmap();
+
+#ifdef _WIN32
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) return false;
+
+    mapped = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (mapped == nullptr) return false;
+#else
+    void *address = ::mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) return false;
+
+    mapped = static_cast<const uint8_t *>(address);
+#endif
+
+    mappedSize = fileSize;
+    return true;
+}
+
+void RegionFile::unmap() {
+#ifdef _WIN32
+    if (mapped != nullptr) UnmapViewOfFile(mapped);
+    if (mapping != nullptr) CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    if (mapped != nullptr) ::munmap(const_cast<uint8_t *>(mapped), mappedSize);
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
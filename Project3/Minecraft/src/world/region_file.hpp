@@ -0,0 +1,87 @@
+#ifndef REGION_FILE_HPP
+#define REGION_FILE_HPP
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/*
+ * One file holding the chunks of a REGION_SIZE x REGION_SIZE area of one layer. The file starts with a table of
+ * where each chunk's payload is (offset and size, 0 when the chunk isn't stored), the payloads follow in any order.
+ * Writes append the new payload and update the table entry in place, the old payload is left behind as waste
+ * until compact rewrites the file with only the live payloads. Reads go through a memory map of the file, so
+ * reading a chunk is a table lookup and a pointer. Every method locks the file, so it can be shared by threads.
+ */
+class RegionFile {
+public:
+    static constexpr int REGION_SIZE = 32;
+    static constexpr int CHUNK_COUNT = REGION_SIZE * REGION_SIZE;
+
+    static int chunkIndex(int localX, int localZ) { return localX + localZ * REGION_SIZE; }
+
+    // Opens the file, creating an empty one when `create` is set and it doesn't exist. Check isOpen after.
+    RegionFile(const std::string &path, bool create);
+    ~RegionFile();
+
+    RegionFile(const RegionFile &) = delete;
+    RegionFile &operator=(const RegionFile &) = delete;
+
+    bool isOpen() const { return opened; }
+
+    // Hands the stored payload to `decode` while the file is locked (the pointer is only valid during the call).
+    // False when the chunk isn't stored or decode fails.
+    bool read(int index, const std::function<bool(const uint8_t *data, size_t size)> &decode);
+
+    // Compacts first when the payload would end past the 4 GiB the table can point into, and fails if it still would.
+    bool write(int index, const uint8_t *data, size_t size);
+
+    // Bytes taken up by payloads that have since been replaced.
+    size_t getWastedBytes();
+    size_t getFileSize();
+
+    // Rewrites the file with only the live payloads, back to back.
+    bool compact();
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::mutex mutex;
+    std::string path;
+    bool opened = false;
+
+    std::array<Entry, CHUNK_COUNT> table {};
+    size_t fileSize = 0;
+    size_t wastedBytes = 0;
+
+    const uint8_t *mapped = nullptr;
+    size_t mappedSize = 0;
+
+#ifdef _WIN32
+    // HANDLEs, nullptr when not open. Kept as void * so windows.h stays out of the header.
+    void *file = nullptr;
+    void *mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+    bool openFile(bool create);
+    void closeFile();
+
+    // compact, with the file already locked.
+    bool compactLocked();
+
+    bool writeAt(size_t offset, const void *data, size_t size);
+
+    // Maps the whole file as it is now, the map has to be redone once the file grows past it.
+    bool map();
+    void unmap();
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "region_store.hpp"
+#include "chunk_map.hpp"
+
+// STD
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    const uint8_t FORMAT_VERSION = 2; // 1 stored whole chunks.
+    constexpr int BLOCK_COUNT = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+
+    // Regions only get compacted once they are big enough for it to matter.
+    constexpr size_t MIN_COMPACT_WASTE = 64 * 1024;
+
+    // Rounds towards negative infinity so negative chunks land in the right region.
+    inline int floorDiv(int value, int divisor) {
+        return (value >= 0) ? value / divisor : (value - divisor + 1) / divisor;
+    }
+
+    inline int floorMod(int value, int divisor) {
+        return value - floorDiv(value, divisor) * divisor;
+    }
+
+    void writeVarint(std::vector<uint8_t> &out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 32 && data < end; shift += 7) {
+            uint8_t byte = *data++;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+}
+
+RegionStore::RegionStore(const std::string &directory) : directory(directory) {
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+
+    saver = std::thread(&RegionStore::saverLoop, this);
+}
+
+RegionStore::~RegionStore() {
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        stopping = true;
+    }
+    saveQueued.notify_all();
+    saver.join();
+}
+
+bool RegionStore::load(const Vec3i &chunkPosition, ChunkEdits &edits) {
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        auto pending = pendingSaves.find(ChunkMap::packKey(chunkPosition[0], chunkPosition[1], chunkPosition[2]));
+        if (pending != pendingSaves.end()) {
+            edits = pending->second.edits;
+            return true;
+        }
+    }
+
+    RegionFile *region = getRegion(chunkPosition, false);
+    if (region == nullptr) return false;
+
+    int index = RegionFile::chunkIndex(floorMod(chunkPosition[0], RegionFile::REGION_SIZE), floorMod(chunkPosition[2], RegionFile::REGION_SIZE));
+    return region->read(index, [&edits](const uint8_t *data, size_t size) { return decode(data, size, edits); });
+}
+
+void RegionStore::save(const Vec3i &chunkPosition, ChunkEdits &&edits) {
+    {
+        std::lock_guard<std::mutex> lock(saveMutex);
+        uint64_t key = ChunkMap::packKey(chunkPosition[0], chunkPosition[1], chunkPosition[2]);
+
+        auto pending = pendingSaves.find(key);
+        if (pending == pendingSaves.end()) {
+            pendingSaves.emplace(key, PendingSave{ chunkPosition, std::move(edits), nextSequence++, true });
+            saveOrder.push_back(key);
+        } else {
+            // Saved again before the last save was written, only the latest edits are written.
+            pending->second.edits = std::move(edits);
+            pending->second.sequence = nextSequence++;
+            if (!pending->second.queued) {
+                pending->second.queued = true;
+                saveOrder.push_back(key);
+            }
+        }
+    }
+    saveQueued.notify_one();
+}
+
+void RegionStore::flush() {
+    std::unique_lock<std::mutex> lock(saveMutex);
+    savesWritten.wait(lock, [this] { return saveOrder.empty() && !writing; });
+}
+
+std::vector<uint8_t> RegionStore::encode(const ChunkEdits &edits) {
+    std::vector<uint8_t> out;
+    out.push_back(FORMAT_VERSION);
+    writeVarint(out, static_cast<uint32_t>(edits.size()));
+
+    int previous = 0;
+    for (const BlockEdit &edit : edits) {
+        writeVarint(out, static_cast<uint32_t>(edit.index - previous));
+        out.push_back(static_cast<uint8_t>(edit.type));
+        previous = edit.index;
+    }
+    return out;
+}
+
+bool RegionStore::decode(const uint8_t *data, size_t size, ChunkEdits &edits) {
+    const uint8_t *end = data + size;
+    if (size < 2 || *data++ != FORMAT_VERSION) return false;
+
+    uint32_t count;
+    if (!readVarint(data, end, count) || count > static_cast<uint32_t>(BLOCK_COUNT)) return false;
+
+    edits.clear();
+    edits.reserve(count);
+
+    uint32_t index = 0;
+    for (uint32_t edit = 0; edit < count; edit++) {
+        uint32_t gap;
+        if (!readVarint(data, end, gap) || data >= end) return false;
+
+        index += gap;
+        uint8_t type = *data++;
+        if (index >= static_cast<uint32_t>(BLOCK_COUNT) || type >= Block::NUM_BLOCKS) return false;
+
+        edits.push_back(BlockEdit{ static_cast<uint16_t>(index), static_cast<Block::BlockType>(type) });
+    }
+    return true;
+}
+
+RegionFile *RegionStore::getRegion(const Vec3i &chunkPosition, bool create) {
+    int regionX = floorDiv(chunkPosition[0], RegionFile::REGION_SIZE);
+    int regionZ = floorDiv(chunkPosition[2], RegionFile::REGION_SIZE);
+    uint64_t key = ChunkMap::packKey(regionX, chunkPosition[1], regionZ);
+
+    std::lock_guard<std::mutex> lock(regionMutex);
+
+    // Regions that don't exist are remembered as nullptr, so missing chunks don't cost a failed open each time.
+    auto found = regions.find(key);
+    if (found != regions.end() && (found->second != nullptr || !create)) return found->second.get();
+
+    std::string path = directory + "/r." + std::to_string(regionX) + "." + std::to_string(chunkPosition[1]) + "." + std::to_string(regionZ) + ".region";
+    std::unique_ptr<RegionFile> region(new RegionFile(path, create));
+    if (!region->isOpen()) {
+        if (create) std::cerr << "Failed to open region file " << path << std::endl;
+        region.reset();
+    }
+
+    RegionFile *opened = region.get();
+    regions[key] = std::move(region);
+    return opened;
+}
+
+void RegionStore::saverLoop() {
+    std::unique_lock<std::mutex> lock(saveMutex);
+    while (true) {
+        saveQueued.wait(lock, [this] { return stopping || !saveOrder.empty(); });
+        if (saveOrder.empty()) return; // Stopping, with everything written.
+
+        uint64_t key = saveOrder.front();
+        saveOrder.pop_front();
+
+        PendingSave &pending = pendingSaves.at(key);
+        pending.queued = false;
+        Vec3i chunkPosition = pending.chunkPosition;
+        ChunkEdits edits = pending.edits;
+        uint64_t sequence = pending.sequence;
+        writing = true;
+
+        lock.unlock();
+        std::vector<uint8_t> payload = encode(edits);
+        RegionFile *region = getRegion(chunkPosition, true);
+        if (region != nullptr) {
+            int index = RegionFile::chunkIndex(floorMod(chunkPosition[0], RegionFile::REGION_SIZE), floorMod(chunkPosition[2], RegionFile::REGION_SIZE));
+            if (!region->write(index, payload.data(), payload.size())) std::cerr << "Failed to save chunk" << std::endl;
+        }
+        lock.lock();
+
+        // Loads read the queue until the file has the chunk, unless it was saved again meanwhile.
+        writing = false;
+        auto written = pendingSaves.find(key);
+        if (written != pendingSaves.end() && written->second.sequence == sequence) pendingSaves.erase(written);
+
+        if (saveOrder.empty()) {
+            savesWritten.notify_all();
+
+            // Idle, a good time to tidy up.
+            lock.unlock();
+            compactRegions();
+            lock.lock();
+        }
+    }
+}
+
+void RegionStore::compactRegions() {
+    std::vector<RegionFile *> wasteful;
+    {
+        std::lock_guard<std::mutex> lock(regionMutex);
+        for (auto &region : regions) {
+            if (region.second == nullptr) continue;
+
+            size_t waste = region.second->getWastedBytes();
+            if (waste >= MIN_COMPACT_WASTE && waste * 2 > region.second->getFileSize()) wasteful.push_back(region.second.get());
+        }
+    }
+
+    // Regions are never closed while the store is open, so the pointers stay good.
+    for (RegionFile *region : wasteful) {
+        if (!region->compact()) std::cerr << "Failed to compact a region file" << std::endl;
+    }
+}
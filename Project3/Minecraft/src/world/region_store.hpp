@@ -0,0 +1,90 @@
+#ifndef REGION_STORE_HPP
+#define REGION_STORE_HPP
+
+#include "block.hpp"
+#include "region_file.hpp"
+
+#include "../maths/vec.hpp"
+
+// STD
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Saved chunks, kept in a directory of region files (see RegionFile), one per REGION_SIZE x REGION_SIZE chunks of
+ * a layer. Saves are queued and written by a background thread, which also compacts regions once enough of them
+ * is waste. Loads may come from any thread, a chunk still waiting to be written is loaded from the queue.
+ *
+ * Only edits are stored: the blocks set since the chunk was generated, which are replayed over the generator's
+ * output on load. Chunks that were never edited aren't in the files at all. A payload is the number of edits then
+ * each edit's block index (as the gap from the last one, edits are sorted) and type.
+ */
+class RegionStore {
+public:
+    // The directory is created if it doesn't exist (not its parents).
+    explicit RegionStore(const std::string &directory);
+
+    // Writes whatever is still queued.
+    ~RegionStore();
+
+    struct BlockEdit {
+        uint16_t index; // As in Chunk::setBlock.
+        Block::BlockType type;
+    };
+
+    // Sorted by index.
+    typedef std::vector<BlockEdit> ChunkEdits;
+
+    // False when the chunk has no saved edits (or they can't be read).
+    bool load(const Vec3i &chunkPosition, ChunkEdits &edits);
+
+    // Queues the chunk's edits to be written, replacing the ones saved before.
+    void save(const Vec3i &chunkPosition, ChunkEdits &&edits);
+
+    // Waits until every queued save is written.
+    void flush();
+
+    static std::vector<uint8_t> encode(const ChunkEdits &edits);
+    static bool decode(const uint8_t *data, size_t size, ChunkEdits &edits);
+
+private:
+    struct PendingSave {
+        Vec3i chunkPosition;
+        ChunkEdits edits;
+        uint64_t sequence; // Tells the saver whether the chunk was saved again while it was writing.
+        bool queued; // In saveOrder, cleared once the saver picks it up.
+    };
+
+    std::string directory;
+
+    std::mutex regionMutex;
+    std::unordered_map<uint64_t, std::unique_ptr<RegionFile>> regions; // Keyed by packed region coordinates.
+
+    std::mutex saveMutex;
+    std::condition_variable saveQueued;
+    std::condition_variable savesWritten;
+    std::unordered_map<uint64_t, PendingSave> pendingSaves; // Keyed by packed chunk coordinates.
+    std::deque<uint64_t> saveOrder;
+    uint64_t nextSequence = 0;
+    bool writing = false;
+    bool stopping = false;
+
+    std::thread saver;
+
+    // nullptr when the region doesn't exist and `create` isn't set.
+    RegionFile *getRegion(const Vec3i &chunkPosition, bool create);
+
+    void saverLoop();
+
+    // Compacts the regions that are more than half waste.
+    void compactRegions();
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include "simplex_noise.hpp"
+
+// std
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMPLEX_NOISE_SSE2
+#endif
+
+namespace {
+    // Skews the plane onto the square lattice and back.
+    const float F2 = 0.366025403784f; // (sqrt(3) - 1) / 2
+    const float G2 = 0.211324865405f; // (3 - sqrt(3)) / 6
+
+    // Eight evenly spread directions, the diagonal ones are longer which the 70 scale below accounts for.
+    const float gradientX[8] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f };
+    const float gradientY[8] = { 1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 1.0f, -1.0f };
+
+    const float F3 = 1.0f / 3.0f;
+    const float G3 = 1.0f / 6.0f;
+
+    // The midpoints of the edges of a cube.
+    const float gradient3X[12] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    const float gradient3Y[12] = { 1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+    const float gradient3Z[12] = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f };
+
+    const float OCTAVE_OFFSET = 17.31f;
+
+    uint64_t splitMix64(uint64_t &state) {
+        uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    inline int fastFloor(float value) {
+        int truncated = static_cast<int>(value);
+        return value < static_cast<float>(truncated) ? truncated - 1 : truncated;
+    }
+
+    // Contribution of one corner of the simplex, (x, y) is the offset from it.
+    inline float corner(float x, float y, int gradient) {
+        float t = std::max(0.5f - x * x - y * y, 0.0f);
+        t = t * t;
+        return t * t * (gradientX[gradient] * x + gradientY[gradient] * y);
+    }
+
+    inline float corner(float x, float y, float z, int gradient) {
+        float t = std::max(0.6f - x * x - y * y - z * z, 0.0f);
+        t = t * t;
+        return t * t * (gradient3X[gradient] * x + gradient3Y[gradient] * y + gradient3Z[gradient] * z);
+    }
+
+#ifdef SIMPLEX_NOISE_SSE2
+    inline __m128i floor4(__m128 value) {
+        __m128i truncated = _mm_cvttps_epi32(value);
+        // The compare is all ones (-1) where truncating rounded up.
+        __m128 roundedUp = _mm_cmplt_ps(value, _mm_cvtepi32_ps(truncated));
+        return _mm_add_epi32(truncated, _mm_castps_si128(roundedUp));
+    }
+#endif
+}
+
+SimplexNoise::SimplexNoise(uint32_t seed) {
+    // Fisher-Yates with our own generator, std::shuffle differs between standard libraries.
+    uint64_t state = seed;
+    for (int i = 0; i < 256; i++) {
+        permutation[i] = static_cast<uint8_t>(i);
+    }
+    for (int i = 255; i > 0; i--) {
+        int j = static_cast<int>(splitMix64(state) % static_cast<uint64_t>(i + 1));
+        std::swap(permutation[i], permutation[j]);
+    }
+    for (int i = 0; i < 256; i++) {
+        permutation[i + 256] = permutation[i];
+    }
+}
+
+float SimplexNoise::sample(float x, float y) const {
+    float s = (x + y) * F2;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+
+    float t = static_cast<float>(i + j) * G2;
+    float x0 = x - (static_cast<float>(i) - t);
+    float y0 = y - (static_cast<float>(j) - t);
+
+    // Which of the two triangles of the lattice square the point is in.
+    int i1 = x0 > y0 ? 1 : 0;
+    int j1 = 1 - i1;
+
+    float x1 = (x0 - static_cast<float>(i1)) + G2;
+    float y1 = (y0 - static_cast<float>(j1)) + G2;
+    float x2 = (x0 - 1.0f) + 2.0f * G2;
+    float y2 = (y0 - 1.0f) + 2.0f * G2;
+
+    int ii = i & 255;
+    int jj = j & 255;
+
+    float n0 = corner(x0, y0, gradientIndex(ii, jj));
+    float n1 = corner(x1, y1, gradientIndex(ii + i1, jj + j1));
+    float n2 = corner(x2, y2, gradientIndex(ii + 1, jj + 1));
+
+    return 70.0f * (n0 + n1 + n2);
+}
+
+void SimplexNoise::sample4(const float x[4], const float y[4], float out[4]) const {
+#ifdef SIMPLEX_NOISE_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 g2 = _mm_set1_ps(G2);
+    const __m128 g2Twice = _mm_set1_ps(2.0f * G2);
+
+    __m128 vx = _mm_loadu_ps(x);
+    __m128 vy = _mm_loadu_ps(y);
+
+    __m128 s = _mm_mul_ps(_mm_add_ps(vx, vy), _mm_set1_ps(F2));
+    __m128i i = floor4(_mm_add_ps(vx, s));
+    __m128i j = floor4(_mm_add_ps(vy, s));
+
+    __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), g2);
+    __m128 x0 = _mm_sub_ps(vx, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+    __m128 y0 = _mm_sub_ps(vy, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+    __m128 i1 = _mm_and_ps(_mm_cmpgt_ps(x0, y0), one);
+    __m128 j1 = _mm_sub_ps(one, i1);
+
+    __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), g2);
+    __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), g2);
+    __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), g2Twice);
+    __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), g2Twice);
+
+    // SSE2 has no gather, the permutation lookups are done a lane at a time.
+    alignas(16) int latticeI[4], latticeJ[4];
+    alignas(16) float triangle[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(latticeI), i);
+    _mm_store_si128(reinterpret_cast<__m128i *>(latticeJ), j);
+    _mm_store_ps(triangle, i1);
+
+    alignas(16) float gradients[3][2][4];
+    for (int lane = 0; lane < 4; lane++) {
+        int ii = latticeI[lane] & 255;
+        int jj = latticeJ[lane] & 255;
+        int step = triangle[lane] > 0.0f ? 1 : 0;
+
+        int corners[3] = { gradientIndex(ii, jj), gradientIndex(ii + step, jj + 1 - step), gradientIndex(ii + 1, jj + 1) };
+        for (int c = 0; c < 3; c++) {
+            gradients[c][0][lane] = gradientX[corners[c]];
+            gradients[c][1][lane] = gradientY[corners[c]];
+        }
+    }
+
+    auto corner4 = [&](__m128 cx, __m128 cy, int c) {
+        __m128 weight = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(cx, cx)), _mm_mul_ps(cy, cy)), _mm_setzero_ps());
+        weight = _mm_mul_ps(weight, weight);
+        __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_load_ps(gradients[c][0]), cx), _mm_mul_ps(_mm_load_ps(gradients[c][1]), cy));
+        return _mm_mul_ps(_mm_mul_ps(weight, weight), dot);
+    };
+
+    __m128 sum = _mm_add_ps(_mm_add_ps(corner4(x0, y0, 0), corner4(x1, y1, 1)), corner4(x2, y2, 2));
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_set1_ps(70.0f), sum));
+#else
+    for (int lane = 0; lane < 4; lane++) {
+        out[lane] = sample(x[lane], y[lane]);
+    }
+#endif
+}
+
+float SimplexNoise::sample(float x, float y, float z) const {
+    float s = (x + y + z) * F3;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    int k = fastFloor(z + s);
+
+    float t = static_cast<float>(i + j + k) * G3;
+    float x0 = x - (static_cast<float>(i) - t);
+    float y0 = y - (static_cast<float>(j) - t);
+    float z0 = z - (static_cast<float>(k) - t);
+
+    // Which of the six tetrahedra of the lattice cube the point is in, from the order of x0, y0 and z0.
+    int i1 = (x0 >= y0 && x0 >= z0) ? 1 : 0;
+    int j1 = (y0 > x0 && y0 >= z0) ? 1 : 0;
+    int k1 = (z0 > x0 && z0 > y0) ? 1 : 0;
+    int i2 = (x0 >= y0 || x0 >= z0) ? 1 : 0;
+    int j2 = (y0 > x0 || y0 >= z0) ? 1 : 0;
+    int k2 = (z0 > x0 || z0 > y0) ? 1 : 0;
+
+    float x1 = (x0 - static_cast<float>(i1)) + G3;
+    float y1 = (y0 - static_cast<float>(j1)) + G3;
+    float z1 = (z0 - static_cast<float>(k1)) + G3;
+    float x2 = (x0 - static_cast<float>(i2)) + 2.0f * G3;
+    float y2 = (y0 - static_cast<float>(j2)) + 2.0f * G3;
+    float z2 = (z0 - static_cast<float>(k2)) + 2.0f * G3;
+    float x3 = (x0 - 1.0f) + 3.0f * G3;
+    float y3 = (y0 - 1.0f) + 3.0f * G3;
+    float z3 = (z0 - 1.0f) + 3.0f * G3;
+
+    int ii = i & 255;
+    int jj = j & 255;
+    int kk = k & 255;
+
+    float n0 = corner(x0, y0, z0, gradientIndex(ii, jj, kk));
+    float n1 = corner(x1, y1, z1, gradientIndex(ii + i1, jj + j1, kk + k1));
+    float n2 = corner(x2, y2, z2, gradientIndex(ii + i2, jj + j2, kk + k2));
+    float n3 = corner(x3, y3, z3, gradientIndex(ii + 1, jj + 1, kk + 1));
+
+    return 32.0f * (n0 + n1 + n2 + n3);
+}
+
+void SimplexNoise::sample4(const float x[4], const float y[4], const float z[4], float out[4]) const {
+#ifdef SIMPLEX_NOISE_SSE2
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 g3 = _mm_set1_ps(G3);
+
+    __m128 vx = _mm_loadu_ps(x);
+    __m128 vy = _mm_loadu_ps(y);
+    __m128 vz = _mm_loadu_ps(z);
+
+    __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(vx, vy), vz), _mm_set1_ps(F3));
+    __m128i i = floor4(_mm_add_ps(vx, s));
+    __m128i j = floor4(_mm_add_ps(vy, s));
+    __m128i k = floor4(_mm_add_ps(vz, s));
+
+    __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), g3);
+    __m128 x0 = _mm_sub_ps(vx, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+    __m128 y0 = _mm_sub_ps(vy, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+    __m128 z0 = _mm_sub_ps(vz, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+    __m128 xGeY = _mm_cmpge_ps(x0, y0);
+    __m128 xGeZ = _mm_cmpge_ps(x0, z0);
+    __m128 yGtX = _mm_cmpgt_ps(y0, x0);
+    __m128 yGeZ = _mm_cmpge_ps(y0, z0);
+    __m128 zGtX = _mm_cmpgt_ps(z0, x0);
+    __m128 zGtY = _mm_cmpgt_ps(z0, y0);
+
+    __m128 i1 = _mm_and_ps(_mm_and_ps(xGeY, xGeZ), one);
+    __m128 j1 = _mm_and_ps(_mm_and_ps(yGtX, yGeZ), one);
+    __m128 k1 = _mm_and_ps(_mm_and_ps(zGtX, zGtY), one);
+    __m128 i2 = _mm_and_ps(_mm_or_ps(xGeY, xGeZ), one);
+    __m128 j2 = _mm_and_ps(_mm_or_ps(yGtX, yGeZ), one);
+    __m128 k2 = _mm_and_ps(_mm_or_ps(zGtX, zGtY), one);
+
+    __m128 corners[4][3] = {
+        { x0, y0, z0 },
+        { _mm_add_ps(_mm_sub_ps(x0, i1), g3), _mm_add_ps(_mm_sub_ps(y0, j1), g3), _mm_add_ps(_mm_sub_ps(z0, k1), g3) },
+        { _mm_add_ps(_mm_sub_ps(x0, i2), _mm_set1_ps(2.0f * G3)), _mm_add_ps(_mm_sub_ps(y0, j2), _mm_set1_ps(2.0f * G3)), _mm_add_ps(_mm_sub_ps(z0, k2), _mm_set1_ps(2.0f * G3)) },
+        { _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(3.0f * G3)), _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(3.0f * G3)), _mm_add_ps(_mm_sub_ps(z0, one), _mm_set1_ps(3.0f * G3)) },
+    };
+
+    // SSE2 has no gather, the permutation lookups are done a lane at a time.
+    alignas(16) int lattice[3][4];
+    alignas(16) float steps[6][4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lattice[0]), i);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lattice[1]), j);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lattice[2]), k);
+    _mm_store_ps(steps[0], i1);
+    _mm_store_ps(steps[1], j1);
+    _mm_store_ps(steps[2], k1);
+    _mm_store_ps(steps[3], i2);
+    _mm_store_ps(steps[4], j2);
+    _mm_store_ps(steps[5], k2);
+
+    alignas(16) float gradients[4][3][4];
+    for (int lane = 0; lane < 4; lane++) {
+        int ii = lattice[0][lane] & 255;
+        int jj = lattice[1][lane] & 255;
+        int kk = lattice[2][lane] & 255;
+        int step[6];
+        for (int n = 0; n < 6; n++) {
+            step[n] = steps[n][lane] > 0.0f ? 1 : 0;
+        }
+
+        int indices[4] = {
+            gradientIndex(ii, jj, kk),
+            gradientIndex(ii + step[0], jj + step[1], kk + step[2]),
+            gradientIndex(ii + step[3], jj + step[4], kk + step[5]),
+            gradientIndex(ii + 1, jj + 1, kk + 1),
+        };
+        for (int c = 0; c < 4; c++) {
+            gradients[c][0][lane] = gradient3X[indices[c]];
+            gradients[c][1][lane] = gradient3Y[indices[c]];
+            gradients[c][2][lane] = gradient3Z[indices[c]];
+        }
+    }
+
+    __m128 sum = _mm_setzero_ps();
+    for (int c = 0; c < 4; c++) {
+        __m128 cx = corners[c][0];
+        __m128 cy = corners[c][1];
+        __m128 cz = corners[c][2];
+
+        __m128 weight = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(cx, cx)), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz));
+        weight = _mm_max_ps(weight, _mm_setzero_ps());
+        weight = _mm_mul_ps(weight, weight);
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(gradients[c][0]), cx), _mm_mul_ps(_mm_load_ps(gradients[c][1]), cy)), _mm_mul_ps(_mm_load_ps(gradients[c][2]), cz));
+        __m128 contribution = _mm_mul_ps(_mm_mul_ps(weight, weight), dot);
+
+        // Summed in the same order as the scalar version, from a first term rather than from zero.
+        sum = c == 0 ? contribution : _mm_add_ps(sum, contribution);
+    }
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_set1_ps(32.0f), sum));
+#else
+    for (int lane = 0; lane < 4; lane++) {
+        out[lane] = sample(x[lane], y[lane], z[lane]);
+    }
+#endif
+}
+
+float SimplexNoise::fractal(float x, float y, int octaves) const {
+    float sum = 0.0f;
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+
+    for (int octave = 0; octave < octaves; octave++) {
+        float offset = static_cast<float>(octave) * OCTAVE_OFFSET;
+        sum += amplitude * sample(x * frequency + offset, y * frequency + offset);
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    return sum / total;
+}
+
+void SimplexNoise::fractal4(const float x[4], const float y[4], int octaves, float out[4]) const {
+    float sum[4] = {};
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+
+    for (int octave = 0; octave < octaves; octave++) {
+        float offset = static_cast<float>(octave) * OCTAVE_OFFSET;
+
+        float octaveX[4], octaveY[4], noise[4];
+        for (int lane = 0; lane < 4; lane++) {
+            octaveX[lane] = x[lane] * frequency + offset;
+            octaveY[lane] = y[lane] * frequency + offset;
+        }
+        sample4(octaveX, octaveY, noise);
+
+        for (int lane = 0; lane < 4; lane++) {
+            sum[lane] += amplitude * noise[lane];
+        }
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    for (int lane = 0; lane < 4; lane++) {
+        out[lane] = sum[lane] / total;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef SIMPLEX_NOISE_HPP
+#define SIMPLEX_NOISE_HPP
+
+// std
+#include <array>
+#include <cstdint>
+
+/*
+ * 2D and 3D simplex noise over a permutation table shuffled from a seed, so the same seed always gives the same
+ * noise. sample4 evaluates four points at once with SSE2 where it is available and gives exactly the same values as
+ * four calls to sample (the same float operations in the same order). The lattice repeats every 256 units.
+ */
+class SimplexNoise {
+public:
+    explicit SimplexNoise(uint32_t seed);
+
+    // In [-1, 1].
+    float sample(float x, float y) const;
+    void sample4(const float x[4], const float y[4], float out[4]) const;
+
+    // In [-1, 1].
+    float sample(float x, float y, float z) const;
+    void sample4(const float x[4], const float y[4], const float z[4], float out[4]) const;
+
+    // Fractal sum of `octaves` samples, each at twice the frequency and half the amplitude of the last.
+    // Normalised back to [-1, 1]. Each octave is offset so they don't line up at the origin.
+    float fractal(float x, float y, int octaves) const;
+    void fractal4(const float x[4], const float y[4], int octaves, float out[4]) const;
+
+private:
+    std::array<uint8_t, 512> permutation; // Two copies of a shuffle of 0-255, so lookups don't need wrapping.
+
+    int gradientIndex(int i, int j) const { return permutation[i + permutation[j]] & 7; }
+    int gradientIndex(int i, int j, int k) const { return permutation[i + permutation[j + permutation[k]]] % 12; }
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "staging_ring.hpp"
+
+// std
+#include <cstring>
+
+constexpr size_t StagingRing::DEFAULT_SIZE;
+
+void StagingRing::destroy() {
+    for (const Fence &fence : fences) {
+        glDeleteSync(fence.sync);
+    }
+    fences.clear();
+
+    if (buffer != 0) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    head = segmentBegin = 0;
+}
+
+void StagingRing::write(GLuint target, size_t offset, const void *data, size_t bytes) {
+    if (bytes == 0) return;
+
+    // The copy buffer bindings are used throughout, so vertex array state is left alone.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+
+    // Too big for the ring, it goes straight in.
+    if (bytes > size) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+        return;
+    }
+
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBufferData(GL_COPY_READ_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+    if (head + bytes > size) {
+        fenceSegment();
+        head = segmentBegin = 0;
+    }
+    if (!isFree(head, head + bytes)) orphan();
+
+    void *mapped = glMapBufferRange(GL_COPY_READ_BUFFER, head, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped == nullptr) {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+        return;
+    }
+    std::memcpy(mapped, data, bytes);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, head, offset, bytes);
+    head += bytes;
+}
+
+void StagingRing::endFrame() {
+    fenceSegment();
+}
+
+void StagingRing::fenceSegment() {
+    if (head == segmentBegin) return;
+
+    fences.push_back(Fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), segmentBegin, head });
+    segmentBegin = head;
+}
+
+bool StagingRing::isFree(size_t begin, size_t end) {
+    for (auto fence = fences.begin(); fence != fences.end();) {
+        if (fence->end <= begin || fence->begin >= end) {
+            ++fence;
+            continue;
+        }
+
+        // Polled, never waited on.
+        GLenum status = glClientWaitSync(fence->sync, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+        glDeleteSync(fence->sync);
+        fence = fences.erase(fence);
+    }
+    return true;
+}
+
+void StagingRing::orphan() {
+    glBufferData(GL_COPY_READ_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+    // Every fence was about the old storage.
+    for (const Fence &fence : fences) {
+        glDeleteSync(fence.sync);
+    }
+    fences.clear();
+    head = segmentBegin = 0;
+    orphanCount++;
+}
@@ -0,0 +1,62 @@
+#ifndef STAGING_RING_HPP
+#define STAGING_RING_HPP
+
+#include <glad/glad.h>
+
+// std
+#include <cstddef>
+#include <deque>
+
+/*
+ * Streams data into buffers through a ring of staging memory, so an upload never has the driver allocate storage or
+ * wait for the GPU. Each write maps the next part of the ring unsynchronized, fills it and has the GPU copy it over.
+ * The ring is fenced once a frame (and when it wraps), and a part of it is only written again once its fence has
+ * passed.
+ *
+ * Persistent mapping needs buffer storage (GL 4.4), which the 3.3 loader doesn't have, so the ring is mapped per
+ * write instead. When it catches up with copies the GPU hasn't done yet, the staging buffer is orphaned rather than
+ * waited on: the driver keeps the old storage alive for those copies and hands out fresh storage.
+ */
+class StagingRing {
+public:
+    static constexpr size_t DEFAULT_SIZE = 4 * 1024 * 1024;
+
+    explicit StagingRing(size_t size = DEFAULT_SIZE) : size(size) {}
+
+    // GL objects are made on first use, destroy has to run while the context is current.
+    void destroy();
+
+    // Copies `bytes` bytes of `data` to `offset` in the `target` buffer.
+    void write(GLuint target, size_t offset, const void *data, size_t bytes);
+
+    // Fences what was written since the last call. Call once per frame.
+    void endFrame();
+
+    // Bytes of GL storage, none until the first write.
+    size_t getMemoryUsage() const { return buffer != 0 ? size : 0; }
+
+    // Times the ring caught up with the GPU and had to be orphaned.
+    size_t getOrphanCount() const { return orphanCount; }
+
+private:
+    struct Fence {
+        GLsync sync;
+        size_t begin, end; // Part of the ring the fenced copies read.
+    };
+
+    GLuint buffer = 0;
+    size_t size;
+    size_t head = 0; // Where the next write goes.
+    size_t segmentBegin = 0; // Start of what was written since the last fence.
+    std::deque<Fence> fences; // Oldest first.
+    size_t orphanCount = 0;
+
+    void fenceSegment();
+
+    // Whether the GPU is done with every copy from begin to end, forgetting the fences that have passed.
+    bool isFree(size_t begin, size_t end);
+
+    void orphan();
+};
+
+#endif
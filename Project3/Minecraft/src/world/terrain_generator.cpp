@@ -0,0 +1,215 @@
+#include "terrain_generator.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    constexpr int COLUMN_COUNT = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+    constexpr int BLOCK_COUNT = COLUMN_COUNT * Chunk::CHUNK_SIZE;
+
+    constexpr int LATTICE_SIZE = NoiseTerrainGenerator::DENSITY_POINTS * NoiseTerrainGenerator::DENSITY_POINTS * NoiseTerrainGenerator::DENSITY_POINTS;
+
+    // The density field has one layer more than the chunk so the top layer can see what is above it.
+    constexpr int FIELD_LAYERS = Chunk::CHUNK_SIZE + 1;
+    constexpr int FIELD_SIZE = COLUMN_COUNT * FIELD_LAYERS;
+
+    // Far enough apart that the overhang and cave noise don't line up.
+    const float CAVE_OFFSET = 101.7f;
+
+    inline int blockIndex(int x, int y, int z) {
+        return x + y * Chunk::CHUNK_SIZE + z * COLUMN_COUNT;
+    }
+}
+
+BlockStorage FlatTerrainGenerator::generate(const Vec3i &chunkPosition) const {
+    std::vector<Block::BlockType> types(BLOCK_COUNT);
+    for (int y = 0; y < Chunk::CHUNK_SIZE; y++) {
+        int worldY = chunkPosition[1] * Chunk::CHUNK_SIZE + y;
+        Block::BlockType type = (worldY == 7) ? Block::GRASS : (worldY < 7 && worldY >= 5) ? Block::DIRT : (worldY < 5) ? Block::STONE : Block::AIR;
+
+        for (int z = 0; z < Chunk::CHUNK_SIZE; z++) {
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                types[blockIndex(x, y, z)] = type;
+            }
+        }
+    }
+    return BlockStorage(types);
+}
+
+NoiseTerrainGenerator::NoiseTerrainGenerator(uint32_t seed)
+    : NoiseTerrainGenerator(seed, Settings()) {}
+
+NoiseTerrainGenerator::NoiseTerrainGenerator(uint32_t seed, const Settings &settings)
+    : noise(seed), settings(settings) {}
+
+BlockStorage NoiseTerrainGenerator::generate(const Vec3i &chunkPosition) const {
+    int heights[COLUMN_COUNT];
+    getHeights(chunkPosition[0], chunkPosition[2], heights);
+
+    int minY = chunkPosition[1] * Chunk::CHUNK_SIZE;
+    int maxY = minY + Chunk::CHUNK_SIZE - 1;
+    int lowest = *std::min_element(heights, heights + COLUMN_COUNT);
+    int highest = *std::max_element(heights, heights + COLUMN_COUNT);
+
+    // Overhangs move the surface by at most their strength, the noise stays within [-1, 1].
+    int overhangReach = static_cast<int>(std::ceil(settings.overhangStrength));
+    bool overhangs = settings.overhangStrength > 0.0f;
+    bool caves = settings.caveThreshold < 1.0f;
+
+    // Most chunks are all sky or all rock, those are uniform and need no indices.
+    if (minY > highest + overhangReach) return BlockStorage(BLOCK_COUNT, Block::AIR);
+
+    float caveLattice[LATTICE_SIZE];
+    bool cavesHere = caves && sampleLattice(chunkPosition, settings.caveScale, CAVE_OFFSET, caveLattice) > settings.caveThreshold;
+    if (maxY < lowest - overhangReach - settings.dirtDepth && !cavesHere) return BlockStorage(BLOCK_COUNT, Block::STONE);
+
+    // Only fields that can change a block are interpolated.
+    float overhangLattice[LATTICE_SIZE];
+    std::vector<float> overhangField, caveField;
+    if (overhangs && minY <= highest + overhangReach && maxY + 1 >= lowest - overhangReach) {
+        sampleLattice(chunkPosition, settings.overhangScale, 0.0f, overhangLattice);
+        overhangField.resize(FIELD_SIZE);
+        interpolateLattice(overhangLattice, overhangField.data());
+    }
+    if (cavesHere) {
+        caveField.resize(FIELD_SIZE);
+        interpolateLattice(caveLattice, caveField.data());
+    }
+
+    // A block is solid below the surface, pushed in or out by the overhang noise, and outside the caves.
+    // Worked out a row at a time, including the layer above the chunk for the grass below.
+    std::vector<uint8_t> solid(FIELD_SIZE);
+    for (int z = 0; z < Chunk::CHUNK_SIZE; z++) {
+        const int *rowHeights = heights + z * Chunk::CHUNK_SIZE;
+        for (int y = 0; y < FIELD_LAYERS; y++) {
+            int field = y * Chunk::CHUNK_SIZE + z * Chunk::CHUNK_SIZE * FIELD_LAYERS;
+            const float *overhang = overhangField.empty() ? nullptr : overhangField.data() + field;
+            const float *cave = caveField.empty() ? nullptr : caveField.data() + field;
+
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                float density = static_cast<float>(rowHeights[x] - (minY + y));
+                if (overhang != nullptr) density += overhang[x] * settings.overhangStrength;
+                bool carved = cave != nullptr && cave[x] > settings.caveThreshold;
+                solid[field + x] = density >= 0.0f && !carved;
+            }
+        }
+    }
+
+    std::vector<Block::BlockType> types(BLOCK_COUNT);
+    for (int z = 0; z < Chunk::CHUNK_SIZE; z++) {
+        const int *rowHeights = heights + z * Chunk::CHUNK_SIZE;
+        for (int y = 0; y < Chunk::CHUNK_SIZE; y++) {
+            const uint8_t *row = solid.data() + y * Chunk::CHUNK_SIZE + z * Chunk::CHUNK_SIZE * FIELD_LAYERS;
+            const uint8_t *above = row + Chunk::CHUNK_SIZE;
+            Block::BlockType *out = types.data() + blockIndex(0, y, z);
+
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                int height = rowHeights[x];
+                int depth = height - (minY + y);
+                bool beach = height <= settings.seaLevel + 1;
+
+                // Near the surface (or sticking out of it) solid blocks are soil, topped with grass where open.
+                Block::BlockType type = Block::AIR;
+                if (row[x] && depth > settings.dirtDepth) type = Block::STONE;
+                else if (row[x] && !above[x]) type = beach ? Block::SAND : Block::GRASS;
+                else if (row[x]) type = beach ? Block::SAND : Block::DIRT;
+
+                out[x] = type;
+            }
+        }
+    }
+    return BlockStorage(types);
+}
+
+void NoiseTerrainGenerator::getHeights(int chunkX, int chunkZ, int heights[]) const {
+    float x[4], z[4], samples[4];
+
+    for (int column = 0; column < COLUMN_COUNT; column += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            x[lane] = static_cast<float>(chunkX * Chunk::CHUNK_SIZE + (column + lane) % Chunk::CHUNK_SIZE) / settings.scale;
+            z[lane] = static_cast<float>(chunkZ * Chunk::CHUNK_SIZE + (column + lane) / Chunk::CHUNK_SIZE) / settings.scale;
+        }
+
+        noise.fractal4(x, z, settings.octaves, samples);
+
+        for (int lane = 0; lane < 4; lane++) {
+            heights[column + lane] = settings.baseHeight + static_cast<int>(std::floor(samples[lane] * settings.amplitude));
+        }
+    }
+}
+
+float NoiseTerrainGenerator::sampleLattice(const Vec3i &chunkPosition, float scale, float offset, float lattice[]) const {
+    // Padded to a multiple of four for sample4.
+    const int paddedSize = (LATTICE_SIZE + 3) & ~3;
+    float x[4], y[4], z[4], samples[4];
+    float largest = -1.0f;
+
+    for (int point = 0; point < paddedSize; point += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            int index = std::min(point + lane, LATTICE_SIZE - 1);
+            int latticeX = index % DENSITY_POINTS;
+            int latticeY = (index / DENSITY_POINTS) % DENSITY_POINTS;
+            int latticeZ = index / (DENSITY_POINTS * DENSITY_POINTS);
+
+            x[lane] = static_cast<float>(chunkPosition[0] * Chunk::CHUNK_SIZE + latticeX * DENSITY_STEP) / scale + offset;
+            y[lane] = static_cast<float>(chunkPosition[1] * Chunk::CHUNK_SIZE + latticeY * DENSITY_STEP) / scale + offset;
+            z[lane] = static_cast<float>(chunkPosition[2] * Chunk::CHUNK_SIZE + latticeZ * DENSITY_STEP) / scale + offset;
+        }
+
+        noise.sample4(x, y, z, samples);
+
+        for (int lane = 0; lane < 4 && point + lane < LATTICE_SIZE; lane++) {
+            lattice[point + lane] = samples[lane];
+            largest = std::max(largest, samples[lane]);
+        }
+    }
+    return largest;
+}
+
+void NoiseTerrainGenerator::interpolateLattice(const float lattice[], float field[]) {
+    // One axis at a time, x then y then z, which is the same as trilinear. The inner loops run along whole rows.
+    // Weighted as a * (1 - f) + b * f so a block on a lattice point gets exactly its value, the same as the
+    // neighbouring chunk gets for it.
+    float alongX[DENSITY_POINTS][DENSITY_POINTS][Chunk::CHUNK_SIZE];
+    float alongY[DENSITY_POINTS][FIELD_LAYERS][Chunk::CHUNK_SIZE];
+
+    auto cellOf = [](int block, float &fraction) {
+        int cell = std::min(block / DENSITY_STEP, DENSITY_POINTS - 2);
+        fraction = static_cast<float>(block - cell * DENSITY_STEP) / DENSITY_STEP;
+        return cell;
+    };
+
+    for (int z = 0; z < DENSITY_POINTS; z++) {
+        for (int y = 0; y < DENSITY_POINTS; y++) {
+            const float *row = lattice + y * DENSITY_POINTS + z * DENSITY_POINTS * DENSITY_POINTS;
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                float fraction;
+                int cell = cellOf(x, fraction);
+                alongX[z][y][x] = row[cell] * (1.0f - fraction) + row[cell + 1] * fraction;
+            }
+        }
+    }
+
+    for (int z = 0; z < DENSITY_POINTS; z++) {
+        for (int y = 0; y < FIELD_LAYERS; y++) {
+            float fraction;
+            int cell = cellOf(y, fraction);
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                alongY[z][y][x] = alongX[z][cell][x] * (1.0f - fraction) + alongX[z][cell + 1][x] * fraction;
+            }
+        }
+    }
+
+    for (int z = 0; z < Chunk::CHUNK_SIZE; z++) {
+        float fraction;
+        int cell = cellOf(z, fraction);
+        for (int y = 0; y < FIELD_LAYERS; y++) {
+            float *out = field + y * Chunk::CHUNK_SIZE + z * Chunk::CHUNK_SIZE * FIELD_LAYERS;
+            for (int x = 0; x < Chunk::CHUNK_SIZE; x++) {
+                out[x] = alongY[cell][y][x] * (1.0f - fraction) + alongY[cell + 1][y][x] * fraction;
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef TERRAIN_GENERATOR_HPP
+#define TERRAIN_GENERATOR_HPP
+
+#include "block_storage.hpp"
+#include "chunk.hpp"
+#include "simplex_noise.hpp"
+
+#include "../maths/vec.hpp"
+
+// std
+#include <cstdint>
+
+/*
+ * Fills in the blocks of newly loaded chunks. Chunks are generated on the worker threads, several at once, so
+ * generate must only read the generator, and give the same blocks for the same chunk every time.
+ */
+class TerrainGenerator {
+public:
+    virtual ~TerrainGenerator() = default;
+
+    virtual BlockStorage generate(const Vec3i &chunkPosition) const = 0;
+};
+
+// The original flat world: grass at world y 7, dirt below it and stone from y 4 down.
+class FlatTerrainGenerator : public TerrainGenerator {
+public:
+    BlockStorage generate(const Vec3i &chunkPosition) const override;
+};
+
+/*
+ * Rolling hills from a fractal simplex noise heightmap. The surface is grass, with sand where it is close to sea
+ * level, over a few layers of dirt and then stone. Chunks entirely above or below the surface are filled without
+ * looking at the blocks one by one.
+ *
+ * A 3D density stage then adds overhangs (3D noise pushing the surface in and out) and caves (carved where a second
+ * 3D noise is high). 3D noise per block would cost 4096 samples a chunk, instead it is sampled every DENSITY_STEP
+ * blocks, 125 samples a chunk, and trilinearly interpolated in between.
+ */
+class NoiseTerrainGenerator : public TerrainGenerator {
+public:
+    struct Settings {
+        int baseHeight = 16;      // Surface height where the noise is 0.
+        float amplitude = 24.0f;  // The surface stays within this many blocks of baseHeight.
+        float scale = 160.0f;     // Width of the largest hills in blocks.
+        int octaves = 5;
+        int seaLevel = 8;         // Surfaces up to a block above this are sand.
+        int dirtDepth = 3;
+
+        float overhangScale = 32.0f;   // Blocks between the bulges of the overhang noise.
+        float overhangStrength = 6.0f; // How many blocks the surface is pushed in or out by, 0 turns overhangs off.
+        float caveScale = 24.0f;       // Blocks between caves.
+        float caveThreshold = 0.55f;   // Caves are carved where the cave noise is above this, 1 turns them off.
+    };
+
+    // Spacing in blocks of the density lattice, the lattice has a point on every cell corner of the chunk.
+    static constexpr int DENSITY_STEP = 4;
+    static constexpr int DENSITY_POINTS = Chunk::CHUNK_SIZE / DENSITY_STEP + 1;
+
+    explicit NoiseTerrainGenerator(uint32_t seed);
+    NoiseTerrainGenerator(uint32_t seed, const Settings &settings);
+
+    BlockStorage generate(const Vec3i &chunkPosition) const override;
+
+    // Surface heights of a chunk's columns, indexed x + z * CHUNK_SIZE. Four columns are sampled at once.
+    void getHeights(int chunkX, int chunkZ, int heights[]) const;
+
+private:
+    SimplexNoise noise;
+    Settings settings;
+
+    // 3D noise at every lattice point of a chunk, indexed x + y * DENSITY_POINTS + z * DENSITY_POINTS^2.
+    // Returns the largest value, interpolated values never go past it. `offset` picks a different part of the noise.
+    float sampleLattice(const Vec3i &chunkPosition, float scale, float offset, float lattice[]) const;
+
+    // Trilinearly interpolates a lattice to every block, plus the layer above the chunk (CHUNK_SIZE + 1 layers),
+    // indexed x + y * CHUNK_SIZE + z * CHUNK_SIZE * (CHUNK_SIZE + 1).
+    static void interpolateLattice(const float lattice[], float field[]);
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "vertex_arena.hpp"
+
+// std
+#include <algorithm>
+#include <iostream>
+
+constexpr uint32_t VertexArena::MAX_SLOTS;
+constexpr uint32_t VertexArena::NO_SLOT;
+constexpr GLsizei VertexArena::INITIAL_CAPACITY;
+
+void VertexArena::destroy() {
+    if (vbo != 0) glDeleteBuffers(1, &vbo);
+    if (vao != 0) glDeleteVertexArrays(1, &vao);
+    if (originBuffer != 0) glDeleteBuffers(1, &originBuffer);
+    if (originTexture != 0) glDeleteTextures(1, &originTexture);
+    staging.destroy();
+
+    vbo = vao = originBuffer = originTexture = 0;
+    capacity = used = 0;
+    freeRanges.clear();
+    origins.clear();
+    freeSlots.clear();
+    uploadedSlots = 0;
+}
+
+GLint VertexArena::allocate(GLsizei count) {
+    auto range = std::find_if(freeRanges.begin(), freeRanges.end(), [count](const std::pair<const GLint, GLsizei> &free) { return free.second >= count; });
+    if (range == freeRanges.end()) {
+        grow(capacity + count);
+        range = std::find_if(freeRanges.begin(), freeRanges.end(), [count](const std::pair<const GLint, GLsizei> &free) { return free.second >= count; });
+    }
+
+    // Taken off the front, the rest stays free.
+    GLint first = range->first;
+    GLsizei left = range->second - count;
+    freeRanges.erase(range);
+    if (left > 0) freeRanges.emplace(first + count, left);
+
+    used += count;
+    return first;
+}
+
+void VertexArena::release(GLint first, GLsizei count) {
+    if (count == 0) return;
+    used -= count;
+
+    // Merge with the free ranges either side.
+    auto next = freeRanges.lower_bound(first);
+    if (next != freeRanges.end() && next->first == first + count) {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == first) {
+            previous->second += count;
+            return;
+        }
+    }
+    freeRanges.emplace(first, count);
+}
+
+void VertexArena::upload(GLint first, const Chunk::Vertex *vertices, GLsizei count) {
+    if (count == 0) return;
+
+    size_t bytes = count * sizeof(Chunk::Vertex);
+    staging.write(vbo, first * sizeof(Chunk::Vertex), vertices, bytes);
+    uploadedBytes += bytes;
+}
+
+uint32_t VertexArena::allocateSlot() {
+    if (!freeSlots.empty()) {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    // A slot past the 24 bits would alias another chunk's, so there just isn't one.
+    uint32_t slot = static_cast<uint32_t>(origins.size() / 4);
+    if (slot >= MAX_SLOTS) {
+        std::cerr << "Out of chunk slots in the vertex arena" << std::endl;
+        return NO_SLOT;
+    }
+    origins.resize(origins.size() + 4, 0.0f);
+    return slot;
+}
+
+void VertexArena::releaseSlot(uint32_t slot) {
+    if (slot != NO_SLOT) freeSlots.push_back(slot);
+}
+
+void VertexArena::setOrigin(uint32_t slot, float x, float y, float z) {
+    if (slot == NO_SLOT) return;
+
+    origins[slot * 4 + 0] = x;
+    origins[slot * 4 + 1] = y;
+    origins[slot * 4 + 2] = z;
+    originsChanged = true;
+}
+
+void VertexArena::bind(ShaderProgram &shader, GLint unit) {
+    if (originTexture == 0) {
+        glGenBuffers(1, &originBuffer);
+        glGenTextures(1, &originTexture);
+    }
+
+    // The whole table goes up at once, it is small and chunks change origin in bursts.
+    if (originsChanged) {
+        glBindBuffer(GL_TEXTURE_BUFFER, originBuffer);
+        size_t slots = origins.size() / 4;
+        if (slots > uploadedSlots) {
+            uploadedSlots = std::max(slots, uploadedSlots * 2);
+            glBufferData(GL_TEXTURE_BUFFER, uploadedSlots * 4 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, origins.size() * sizeof(float), origins.data());
+        originsChanged = false;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, originTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, originBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    shader.setUniform("u_chunk_origins", unit);
+
+    glBindVertexArray(vao);
+}
+
+void VertexArena::draw(const Chunk::DrawList &draws) const {
+    if (draws.empty()) return;
+
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, draws.counts.data(), GL_UNSIGNED_SHORT, draws.indices.data(), static_cast<GLsizei>(draws.counts.size()), draws.baseVertices.data());
+}
+
+void VertexArena::trim() {
+    if (freeRanges.empty()) return;
+
+    // Only a free range running to the end can go.
+    auto last = std::prev(freeRanges.end());
+    if (last->first + last->second != capacity) return;
+
+    // Half of the result stays free, so it doesn't have to grow again right away.
+    GLsizei end = last->first;
+    GLsizei newCapacity = capacity;
+    while (newCapacity / 2 >= INITIAL_CAPACITY && newCapacity / 2 >= end * 2) newCapacity /= 2;
+    if (newCapacity == capacity) return;
+
+    GLsizei removed = capacity - newCapacity;
+    resize(newCapacity);
+    last->second -= removed;
+    if (last->second == 0) freeRanges.erase(last);
+}
+
+void VertexArena::grow(GLsizei minimum) {
+    GLsizei newCapacity = std::max({ minimum, capacity * 2, INITIAL_CAPACITY });
+    GLint first = capacity;
+    resize(newCapacity);
+
+    // The new space is free, joined onto a free range at the old end if there is one.
+    GLsizei added = newCapacity - first;
+    used += added; // release takes it back off.
+    release(first, added);
+}
+
+void VertexArena::resize(GLsizei newCapacity) {
+    GLuint newVbo;
+    glGenBuffers(1, &newVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, newVbo);
+    glBufferData(GL_ARRAY_BUFFER, newCapacity * sizeof(Chunk::Vertex), nullptr, GL_STATIC_DRAW);
+
+    if (vbo != 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, std::min(capacity, newCapacity) * sizeof(Chunk::Vertex));
+        glDeleteBuffers(1, &vbo);
+    } else {
+        glGenVertexArrays(1, &vao);
+    }
+    vbo = newVbo;
+
+    glBindVertexArray(vao);
+
+    // The element buffer binding is part of the vao, every chunk shares the same one.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Chunk::getQuadIndexBuffer());
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(Chunk::Vertex), (const void *)0);
+
+    capacity = newCapacity;
+}
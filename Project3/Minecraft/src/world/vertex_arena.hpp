@@ -0,0 +1,92 @@
+#ifndef VERTEX_ARENA_HPP
+#define VERTEX_ARENA_HPP
+
+#include "chunk.hpp"
+#include "staging_ring.hpp"
+
+#include <glad/glad.h>
+
+// std
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+ * One vertex buffer shared by every chunk mesh, so the world can draw all of them with a single call. Chunks take
+ * ranges of it from a free list (first fit, freed ranges merge with free neighbours). When nothing fits the buffer
+ * grows by copying it on the GPU, ranges keep their place. Nothing ever moves a range, so the buffer can only shrink
+ * back (trim) once its end is free.
+ *
+ * GL 3.3 has no draw id, so a draw can't tell which chunk it is. Every chunk gets a slot in a table of chunk origins
+ * instead (a texture buffer), and its vertices carry the slot (see Chunk::Vertex).
+ *
+ * Vertices go up through a staging ring, so uploading a mesh never stalls on the buffer being drawn from.
+ *
+ * GL objects are made on first use and go with destroy, which has to run while the context is current.
+ */
+class VertexArena {
+public:
+    // Slots have to fit the 24 bits a vertex has for them.
+    static constexpr uint32_t MAX_SLOTS = 1u << 24;
+    // What allocateSlot gives when they have all been taken. Releasing it or setting its origin does nothing.
+    static constexpr uint32_t NO_SLOT = MAX_SLOTS;
+
+    void destroy();
+
+    // First vertex of a free range of `count` vertices.
+    GLint allocate(GLsizei count);
+    void release(GLint first, GLsizei count);
+
+    void upload(GLint first, const Chunk::Vertex *vertices, GLsizei count);
+
+    // Call once per frame, after the frame's uploads.
+    void endFrame() { staging.endFrame(); }
+
+    // Halves the buffer while the ranges in use would fit in half of what is left, dropping the free end.
+    void trim();
+
+    uint32_t allocateSlot();
+    void releaseSlot(uint32_t slot);
+    void setOrigin(uint32_t slot, float x, float y, float z);
+
+    // Binds the vao, and the origin table to texture `unit` as the shader's u_chunk_origins. Call before drawing.
+    void bind(ShaderProgram &shader, GLint unit);
+
+    // One call for every draw in the list, the arena has to be bound.
+    void draw(const Chunk::DrawList &draws) const;
+
+    GLsizei getCapacity() const { return capacity; }
+    GLsizei getUsedVertices() const { return used; }
+    size_t getFreeRangeCount() const { return freeRanges.size(); }
+    uint64_t getUploadedBytes() const { return uploadedBytes; }
+    size_t getStagingOrphanCount() const { return staging.getOrphanCount(); }
+
+    // Bytes of GL storage held, used or not: the vertex buffer, the origin table and the staging ring.
+    size_t getGpuMemoryUsage() const { return capacity * sizeof(Chunk::Vertex) + uploadedSlots * 4 * sizeof(float) + staging.getMemoryUsage(); }
+
+private:
+    static constexpr GLsizei INITIAL_CAPACITY = 512 * 1024;
+
+    GLuint vbo = 0;
+    GLuint vao = 0;
+    GLsizei capacity = 0; // In vertices.
+    GLsizei used = 0;
+    std::map<GLint, GLsizei> freeRanges; // First vertex to count, no two are next to each other.
+    StagingRing staging;
+    uint64_t uploadedBytes = 0; // Since the start, callers budget on the difference.
+
+    GLuint originBuffer = 0;
+    GLuint originTexture = 0;
+    std::vector<float> origins; // Four per slot, the fourth is unused (there is no three float buffer format).
+    std::vector<uint32_t> freeSlots;
+    size_t uploadedSlots = 0; // Slots the origin buffer has room for.
+    bool originsChanged = false;
+
+    // Makes the buffer at least `minimum` vertices, keeping what is in it.
+    void grow(GLsizei minimum);
+
+    // Moves to a new buffer of `newCapacity` vertices, copying over as much of the old one as fits.
+    void resize(GLsizei newCapacity);
+};
+
+#endif
@@ -1,55 +1,666 @@
 #include "world.hpp"
+#include "chunk_visibility.hpp"
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+    // Rounds towards negative infinity so negative blocks land in the right chunk.
+    inline int floorDiv(int value, int divisor) {
+        return (value >= 0) ? value / divisor : (value - divisor + 1) / divisor;
+    }
+
+    Vec3i chunkContaining(const Vec3f &position) {
+        return Vec3i(
+            floorDiv(static_cast<int>(std::floor(position[0] / Block::BLOCK_SCALE)), Chunk::CHUNK_SIZE),
+            floorDiv(static_cast<int>(std::floor(position[1] / Block::BLOCK_SCALE)), Chunk::CHUNK_SIZE),
+            floorDiv(static_cast<int>(std::floor(position[2] / Block::BLOCK_SCALE)), Chunk::CHUNK_SIZE));
+    }
+
+    // Texture unit of the chunk origin table, see VertexArena. The texture atlas is on unit 0.
+    constexpr GLint ORIGIN_TEXTURE_UNIT = 1;
+
+    // Chunk offsets of the neighbours across each face, in ChunkVisibility's order.
+    const int faceOffsets[6][3] = { {0, 0, -1}, {0, 0, 1}, {0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0} };
+}
+
+constexpr uint32_t World::DEFAULT_SEED;
 
 World::World(int chunkLoadRadius, int worldSize)
-    : chunkLoadRadius(chunkLoadRadius), worldSize(worldSize) {
+    : chunkLoadRadius(chunkLoadRadius), worldSize(worldSize), terrainGenerator(std::make_shared<NoiseTerrainGenerator>(DEFAULT_SEED)) {
 
 
 }
 
 World::~World() {
-    for (auto chunk : chunks) {
-        chunk.second.destroy();
-    }
+    workers.stop();
+
+    saveAllChunks();
+    regionStore.reset(); // Only shared with jobs, which are gone with the workers.
+
+    clearAllChunks();
+    arena.destroy();
+    Chunk::destroyQuadIndexBuffer();
 }
 
 void World::initChunks() {
-    loadAllChunks();
+    // Everything in range of the starting point is loaded up front (generated in parallel all the same),
+    // later loads are spread over frames.
+    queueChunkLoads();
+    residencyChanged = false;
+    submitChunkLoads(pendingLoads.size());
+
+    while (!generatingChunks.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        collectGeneratedChunks();
+    }
+}
+
+void World::setTerrainGenerator(std::shared_ptr<const TerrainGenerator> generator) {
+    terrainGenerator = std::move(generator);
+
+    // Everything loaded came from the old generator, but edits are kept apart from it and go on top of the new one.
+    // Unloaded chunks were saved as they went.
+    saveAllChunks();
+    clearAllChunks();
+}
+
+void World::setSaveDirectory(const std::string &directory) {
+    regionStore = std::make_shared<RegionStore>(directory);
+}
+
+void World::saveAllChunks() {
+    if (regionStore == nullptr) return;
+
+    for (Chunk &chunk : chunks) {
+        saveChunk(chunk);
+    }
+    regionStore->flush();
 }
 
-void World::render(const Vec3f& playerPosition) {
-    // Render all loaded chunks.
-    for (auto& [key, chunk] : chunks) {
-        chunk.render();
+void World::saveChunk(Chunk &chunk) {
+    if (regionStore == nullptr || !chunk.hasUnsavedChanges()) return;
+
+    // Everything else comes back from the generator.
+    RegionStore::ChunkEdits edits;
+    for (uint16_t index : chunk.getEditedBlocks()) {
+        edits.push_back(RegionStore::BlockEdit{ index, chunk.getBlockStorage().get(index) });
     }
+
+    regionStore->save(chunk.getChunkPos(), std::move(edits));
+    chunk.setUnsavedChanges(false);
 }
 
-std::string World::chunkKey(int x, int z) {
-    return std::to_string(x) + "_" + std::to_string(z); // Chunk key: "x_z"
+void World::render(ShaderProgram &shader, const Vec3f& playerPosition, const Frustum &frustum) {
+    frame++;
+    updateResidentChunks(playerPosition);
+    updateLevelsOfDetail(playerPosition);
+    updateMemoryBudget();
+
+    renderStats = RenderStats();
+    findVisibleChunks(playerPosition, frustum);
+
+    arena.bind(shader, ORIGIN_TEXTURE_UNIT);
+    if (occlusionCulling) {
+        renderWithOcclusionQueries(playerPosition);
+        return;
+    }
+
+    // Every visible section of every chunk in one call.
+    draws.clear();
+    for (Chunk *chunk : visibleChunks) {
+        chunk->addDraws(draws);
+        renderStats.chunksDrawn++;
+        renderStats.verticesDrawn += chunk->getVertexCount();
+    }
+    arena.draw(draws);
 }
 
-Chunk *World::getChunk(const std::string &key) {
-    if (chunks.find(key) == nullptr) return nullptr;
-    return &chunks.at(key);
+void World::findVisibleChunks(const Vec3f &cameraPosition, const Frustum &frustum) {
+    const float chunkExtent = Chunk::CHUNK_SIZE * Block::BLOCK_SCALE;
+    auto inFrustum = [&](const Vec3i &pos) {
+        renderStats.chunksTested++;
+        Vec3f min(pos[0] * chunkExtent, pos[1] * chunkExtent, pos[2] * chunkExtent);
+        return frustum.intersectsBox(min, min + Vec3f(chunkExtent, chunkExtent, chunkExtent));
+    };
+
+    // The search only goes through the loaded range. From a camera outside of it (off the edge of a fixed world)
+    // there is no way in, so everything in the frustum is drawn instead.
+    Vec3i start = chunkContaining(cameraPosition);
+
+    visibleChunks.clear();
+    if (!caveCulling || !isResident(start, unloadMargin)) {
+        for (Chunk &chunk : chunks) {
+            if (chunk.getVertexCount() != 0 && inFrustum(chunk.getChunkPos())) visibleChunks.push_back(&chunk);
+        }
+        return;
+    }
+
+    // The camera's own chunk is seen from the inside, so every face of it is open.
+    visibilitySearch.clear();
+    searchedChunks.clear();
+    visibilitySearch.push_back(VisibilityStep{ start, -1, 0 });
+    searchedChunks.insert(ChunkMap::packKey(start[0], start[1], start[2]));
+
+    for (size_t next = 0; next < visibilitySearch.size(); next++) {
+        const VisibilityStep step = visibilitySearch[next];
+        Chunk *chunk = getChunk(step.chunkPosition[0], step.chunkPosition[1], step.chunkPosition[2]);
+        if (chunk != nullptr && chunk->getVertexCount() != 0) visibleChunks.push_back(chunk);
+
+        for (int face = 0; face < 6; face++) {
+            if (step.directions & (1u << (face ^ 1))) continue;
+            if (chunk != nullptr && step.entryFace >= 0 && !ChunkVisibility::connects(chunk->getVisibility(), step.entryFace, face)) continue;
+
+            Vec3i pos = step.chunkPosition + Vec3i(faceOffsets[face][0], faceOffsets[face][1], faceOffsets[face][2]);
+            if (!isResident(pos, unloadMargin)) continue;
+            if (!searchedChunks.insert(ChunkMap::packKey(pos[0], pos[1], pos[2])).second) continue;
+            if (!inFrustum(pos)) continue;
+
+            visibilitySearch.push_back(VisibilityStep{ pos, face ^ 1, step.directions | (1u << face) });
+        }
+    }
+    renderStats.chunksVisited = visibilitySearch.size();
+}
+
+void World::renderWithOcclusionQueries(const Vec3f &cameraPosition) {
+    Vec3i cameraChunk = chunkContaining(cameraPosition);
+    auto distance = [&](const Chunk *chunk) {
+        Vec3i offset = chunk->getChunkPos() - cameraChunk;
+        return offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
+    };
+
+    // Near to far, so the chunks drawn first can hide the ones behind them.
+    std::sort(visibleChunks.begin(), visibleChunks.end(), [&](const Chunk *a, const Chunk *b) { return distance(a) < distance(b); });
+
+    occludedChunks.clear();
+    for (Chunk *chunk : visibleChunks) {
+        chunk->collectOcclusionQuery(frame);
+
+        // The camera may be inside the boxes of the chunks around it, which then don't cover what it sees.
+        Vec3i offset = chunk->getChunkPos() - cameraChunk;
+        bool nearCamera = std::abs(offset[0]) <= 1 && std::abs(offset[1]) <= 1 && std::abs(offset[2]) <= 1;
+        if (nearCamera) {
+            chunk->setOccluded(false);
+        } else if (chunk->isOccluded()) {
+            occludedChunks.push_back(chunk);
+            continue;
+        }
+
+        bool query = !nearCamera && !chunk->isOcclusionQueryPending();
+        if (query) chunk->beginOcclusionQuery();
+        chunk->render();
+        if (query) {
+            chunk->endOcclusionQuery();
+            renderStats.occlusionQueries++;
+        }
+
+        renderStats.chunksDrawn++;
+        renderStats.verticesDrawn += chunk->getVertexCount();
+    }
+
+    // The boxes are tested against everything drawn above, without drawing anything themselves.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    for (Chunk *chunk : occludedChunks) {
+        renderStats.chunksOccluded++;
+        if (chunk->isOcclusionQueryPending()) continue;
+
+        chunk->beginOcclusionQuery();
+        chunk->renderBoundingBox();
+        chunk->endOcclusionQuery();
+        renderStats.occlusionQueries++;
+    }
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
-void World::loadAllChunks() {
-    // Generate all chunks within the fixed world size
-    for (int x = 0; x < worldSize; ++x) {
-        for (int z = 0; z < worldSize; ++z) {
-            loadChunk(x, z);
+void World::update() {
+    // Snapshot the oldest dirty chunks for the workers, later edits just queue the chunk again.
+    for (int submitted = 0; submitted < maxRemeshesPerFrame && !dirtyChunks.empty();) {
+        const Vec3i pos = dirtyChunks.front();
+        dirtyChunks.pop_front();
+
+        Chunk *chunk = getChunk(pos[0], pos[1], pos[2]);
+        if (chunk == nullptr || !chunk->isDirty()) continue;
+
+        // Downsampled chunks have their sections counted in cells, so they are always meshed whole.
+        int scale = Chunk::lodScale(chunk->getLodLevel());
+        uint32_t sections = scale == 1 ? chunk->getDirtySections() : Chunk::ALL_SECTIONS;
+        uint32_t version = chunk->beginRemesh(sections);
+
+        Chunk::Neighbours neighbours = getNeighbours(*chunk);
+        bool meshEmpty = chunk->isMeshEmpty(neighbours);
+
+        // Only full detail jobs work out the visibility, the rest is rare enough (an edit far from the player,
+        // or a uniform chunk which is quick) to do here.
+        if (chunk->isVisibilityStale() && (scale != 1 || meshEmpty)) chunk->updateVisibility();
+
+        // Nothing to draw means nothing for the workers to do either, and it doesn't count towards the cap.
+        if (meshEmpty) {
+            chunk->uploadMesh(sections, version, Chunk::SectionMeshes());
+            continue;
         }
+
+        Chunk::PaddedBlocks padded = scale == 1 ? chunk->buildPaddedBlocks(neighbours) : chunk->buildDownsampledBlocks(neighbours, scale);
+        workers.submit(ChunkWorkerPool::MeshJob{ chunk->getChunkPos(), version, sections, scale, Chunk::getMeshingMode(), Chunk::getCullingKernel(), Chunk::getAmbientOcclusion(), std::move(padded) });
+        submitted++;
+    }
+
+    finishedMeshes.clear();
+    workers.collectFinished(finishedMeshes);
+    for (ChunkWorkerPool::MeshResult &result : finishedMeshes) {
+        uploadQueue.push_back(std::move(result));
+    }
+
+    // Upload what finished until the budget is spent, the chunk skips sections that were superseded while they
+    // waited. Chunks that are gone are skipped here.
+    const auto start = std::chrono::steady_clock::now();
+    const std::chrono::microseconds timeBudget(uploadBudgetMicroseconds);
+    const uint64_t startBytes = arena.getUploadedBytes();
+    for (bool first = true; !uploadQueue.empty(); first = false) {
+        if (!first && (arena.getUploadedBytes() - startBytes >= uploadBudgetBytes || std::chrono::steady_clock::now() - start >= timeBudget)) break;
+
+        ChunkWorkerPool::MeshResult result = std::move(uploadQueue.front());
+        uploadQueue.pop_front();
+
+        Chunk *chunk = getChunk(result.chunkPosition[0], result.chunkPosition[1], result.chunkPosition[2]);
+        if (chunk != nullptr) {
+            if (result.hasVisibility) chunk->setVisibility(result.visibility, result.version);
+            chunk->uploadMesh(result.sections, result.version, std::move(result.meshes));
+        }
+    }
+    arena.endFrame();
+}
+
+void World::setMeshingMode(Chunk::MeshingMode mode) {
+    if (Chunk::getMeshingMode() == mode) return;
+
+    Chunk::setMeshingMode(mode);
+    for (Chunk &chunk : chunks) {
+        markChunkDirty(chunk);
+    }
+}
+
+void World::setCullingKernel(Chunk::CullingKernel kernel) {
+    if (Chunk::getCullingKernel() == kernel) return;
+
+    Chunk::setCullingKernel(kernel);
+    for (Chunk &chunk : chunks) {
+        markChunkDirty(chunk);
     }
 }
 
-void World::loadChunk(int x, int z) {
-    std::string key = chunkKey(x, z);
+void World::setAmbientOcclusion(bool enabled) {
+    if (Chunk::getAmbientOcclusion() == enabled) return;
 
-    // If the chunk is not loaded, generate and load it.
-    if (chunks.find(key) == chunks.end()) {
-        chunks.emplace(key, Chunk(x, 0, z));
+    Chunk::setAmbientOcclusion(enabled);
+    for (Chunk &chunk : chunks) {
+        markChunkDirty(chunk);
+    }
+}
+
+void World::setBlock(int x, int y, int z, Block::BlockType type) {
+    Vec3i chunkPos = { floorDiv(x, Chunk::CHUNK_SIZE), floorDiv(y, Chunk::CHUNK_SIZE), floorDiv(z, Chunk::CHUNK_SIZE) };
+    Chunk *chunk = getChunk(chunkPos[0], chunkPos[1], chunkPos[2]);
+    if (chunk == nullptr) return;
+
+    Vec3i local = { x - chunkPos[0] * Chunk::CHUNK_SIZE, y - chunkPos[1] * Chunk::CHUNK_SIZE, z - chunkPos[2] * Chunk::CHUNK_SIZE };
+    chunk->setBlock(local[0], local[1], local[2], type);
+    chunk->setLastUsedFrame(frame);
+
+    // The edit has to show up even if the budget took the mesh.
+    if (chunk->isMeshDropped()) restoreMesh(*chunk);
+
+    // The block's own faces and the faces and corner shading of the blocks next to it.
+    markChunkDirty(*chunk, local[1] - 1, local[1] + 1);
+
+    // Blocks on the edge of a chunk are part of the neighbours' mesh borders too.
+    markNeighboursDirty(chunkPos, &local);
+}
+
+Chunk::Neighbours World::getNeighbours(const Chunk &chunk) {
+    Vec3i pos = chunk.getChunkPos();
+
+    Chunk::Neighbours neighbours;
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                const Chunk *neighbour = (dx == 0 && dy == 0 && dz == 0) ? &chunk : getChunk(pos[0] + dx, pos[1] + dy, pos[2] + dz);
+
+                // Neither side culls against a neighbour at another level of detail, their blocks don't line up.
+                // The faces along that border are drawn on both sides instead, which closes the seam.
+                if (neighbour != nullptr && neighbour->getLodLevel() != chunk.getLodLevel()) neighbour = nullptr;
+
+                neighbours[Chunk::neighbourIndex(dx, dy, dz)] = neighbour;
+            }
+        }
+    }
+    return neighbours;
+}
+
+void World::updateLevelsOfDetail(const Vec3f &playerPosition) {
+    const float chunkExtent = Chunk::CHUNK_SIZE * Block::BLOCK_SCALE;
+
+    for (Chunk &chunk : chunks) {
+        // Distance in chunks from the player to the middle of the chunk.
+        Vec3i pos = chunk.getChunkPos();
+        Vec3f centre((pos[0] + 0.5f) * chunkExtent, (pos[1] + 0.5f) * chunkExtent, (pos[2] + 0.5f) * chunkExtent);
+        float distance = (centre - playerPosition).length() / chunkExtent;
+
+        int level = 0;
+        while (level < Chunk::LOD_LEVELS - 1 && distance > lodDistances[level])
+            level++;
+
+        if (level == chunk.getLodLevel()) continue;
+
+        // The neighbours change how they cull against this chunk as well.
+        chunk.setLodLevel(level);
+        markChunkDirty(chunk);
+        markNeighboursDirty(pos);
+    }
+}
+
+void World::markNeighboursDirty(const Vec3i &chunkPos, const Vec3i *localBlock) {
+    // Whether a neighbour `offset` chunks away along an axis borders the block.
+    auto touches = [&](int axis, int offset) {
+        if (offset == 0 || localBlock == nullptr) return true;
+        return (*localBlock)[axis] == (offset < 0 ? 0 : Chunk::CHUNK_SIZE - 1);
+    };
+
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dx == 0 && dy == 0 && dz == 0) continue;
+                if (!touches(0, dx) || !touches(1, dy) || !touches(2, dz)) continue;
+
+                Chunk *neighbour = getChunk(chunkPos[0] + dx, chunkPos[1] + dy, chunkPos[2] + dz);
+                if (neighbour == nullptr) continue;
+
+                if (localBlock == nullptr) {
+                    markChunkDirty(*neighbour);
+                } else {
+                    // Only the sections around the block's layer, in the neighbour's coordinates.
+                    int y = (*localBlock)[1] - dy * Chunk::CHUNK_SIZE;
+                    markChunkDirty(*neighbour, y - 1, y + 1);
+                }
+            }
+        }
+    }
+}
+
+void World::markChunkDirty(Chunk &chunk) {
+    if (chunk.isMeshDropped()) return;
+    if (!chunk.isDirty()) dirtyChunks.push_back(chunk.getChunkPos());
+    chunk.markDirty();
+}
+
+void World::markChunkDirty(Chunk &chunk, int minY, int maxY) {
+    if (chunk.isMeshDropped()) return;
+    bool wasDirty = chunk.isDirty();
+    chunk.markDirty(minY, maxY);
+    if (!wasDirty && chunk.isDirty()) dirtyChunks.push_back(chunk.getChunkPos());
+}
+
+void World::restoreMesh(Chunk &chunk) {
+    if (!chunk.isDirty()) dirtyChunks.push_back(chunk.getChunkPos());
+    chunk.markDirty();
+}
+
+bool World::isResident(const Vec3i &pos, int margin) const {
+    if (std::abs(pos[1] - residentCentre[1]) > verticalLoadRadius + margin) return false;
+    if (!streaming) return pos[0] >= 0 && pos[0] < worldSize && pos[2] >= 0 && pos[2] < worldSize;
+
+    int dx = pos[0] - residentCentre[0];
+    int dz = pos[2] - residentCentre[2];
+    int radius = chunkLoadRadius + margin;
+    return dx * dx + dz * dz <= radius * radius;
+}
+
+void World::queueChunkLoads() {
+    pendingLoads.clear();
+
+    int minX = streaming ? residentCentre[0] - chunkLoadRadius : 0;
+    int maxX = streaming ? residentCentre[0] + chunkLoadRadius : worldSize - 1;
+    int minZ = streaming ? residentCentre[2] - chunkLoadRadius : 0;
+    int maxZ = streaming ? residentCentre[2] + chunkLoadRadius : worldSize - 1;
+
+    for (int x = minX; x <= maxX; ++x) {
+        for (int y = residentCentre[1] - verticalLoadRadius; y <= residentCentre[1] + verticalLoadRadius; ++y) {
+            for (int z = minZ; z <= maxZ; ++z) {
+                Vec3i pos(x, y, z);
+                if (isResident(pos, 0) && getChunk(x, y, z) == nullptr && generatingChunks.count(ChunkMap::packKey(x, y, z)) == 0) {
+                    pendingLoads.push_back(pos);
+                }
+            }
+        }
+    }
+
+    // Nearest last, loads are taken off the back.
+    auto distance = [this](const Vec3i &pos) {
+        Vec3i offset = pos - residentCentre;
+        return offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
+    };
+    std::sort(pendingLoads.begin(), pendingLoads.end(), [&](const Vec3i &a, const Vec3i &b) { return distance(a) > distance(b); });
+}
+
+void World::submitChunkLoads(size_t maxGenerating) {
+    while (generatingChunks.size() < maxGenerating && !pendingLoads.empty()) {
+        Vec3i pos = pendingLoads.back();
+        pendingLoads.pop_back();
+
+        generatingChunks.insert(ChunkMap::packKey(pos[0], pos[1], pos[2]));
+        workers.submit(ChunkWorkerPool::TerrainJob{ pos, terrainGenerator, regionStore });
+    }
+}
+
+void World::collectGeneratedChunks() {
+    generatedChunks.clear();
+    workers.collectFinished(generatedChunks);
+
+    for (ChunkWorkerPool::TerrainResult &result : generatedChunks) {
+        // Left over from before the generator was replaced, the chunk is being generated again.
+        if (result.generator != terrainGenerator) continue;
+
+        const Vec3i &pos = result.chunkPosition;
+        generatingChunks.erase(ChunkMap::packKey(pos[0], pos[1], pos[2]));
+
+        // The player may have moved on while it was generating.
+        if (!isResident(pos, unloadMargin)) continue;
+
+        Chunk *chunk = loadChunk(pos[0], pos[1], pos[2], std::move(result.blocks));
+        if (chunk != nullptr) {
+            chunk->setEditedBlocks(std::move(result.editedBlocks));
+            chunk->setVisibility(result.visibility);
+        }
+    }
+}
+
+Chunk *World::loadChunk(int x, int y, int z, BlockStorage &&blocks) {
+    if (getChunk(x, y, z) != nullptr) return nullptr;
+
+    // Unloaded chunks are recycled, which saves recreating their GL objects.
+    std::unique_ptr<Chunk> chunk;
+    if (!freeChunks.empty()) {
+        chunk = std::move(freeChunks.back());
+        freeChunks.pop_back();
+        chunk->reset(x, y, z, std::move(blocks));
+    } else {
+        chunk.reset(new Chunk(arena, x, y, z, std::move(blocks)));
+    }
+
+    Chunk &loaded = chunks.insert(std::move(chunk));
+    dirtyChunks.push_back(Vec3i(x, y, z)); // New chunks start out dirty.
+
+    // The new chunk hides faces on the borders of the chunks around it.
+    markNeighboursDirty(Vec3i(x, y, z));
+    return &loaded;
+}
+
+void World::updateResidentChunks(const Vec3f &playerPosition) {
+    Vec3i centre = chunkContaining(playerPosition);
+
+    if (residencyChanged || centre[0] != residentCentre[0] || centre[1] != residentCentre[1] || centre[2] != residentCentre[2]) {
+        residencyChanged = false;
+        residentCentre = centre;
+
+        // Chunks only go once they are unloadMargin past the load range, so walking back and forth over the
+        // edge doesn't load and unload the same chunks over and over.
+        std::vector<Vec3i> unloaded;
+        for (Chunk &chunk : chunks) {
+            if (!isResident(chunk.getChunkPos(), unloadMargin)) unloaded.push_back(chunk.getChunkPos());
+        }
+
+        for (const Vec3i &pos : unloaded) {
+            std::unique_ptr<Chunk> chunk = chunks.extract(pos[0], pos[1], pos[2]);
+            saveChunk(*chunk);
+            freeChunks.push_back(std::move(chunk));
+        }
+
+        // The chunks next to the ones that went now have an open border.
+        for (const Vec3i &pos : unloaded) {
+            markNeighboursDirty(pos);
+        }
+
+        queueChunkLoads();
+    }
+
+    collectGeneratedChunks();
+    submitChunkLoads(maxGeneratingChunks);
+}
+
+void World::updateMemoryBudget() {
+    // Whatever last frame freed at the end of the arena goes before it is measured.
+    arena.trim();
+
+    MemoryUsage usage;
+    size_t rangeBytes = 0; // The part of the arena the loaded chunks' ranges take.
+    for (Chunk &chunk : chunks) {
+        if (isResident(chunk.getChunkPos(), 0)) chunk.setLastUsedFrame(frame);
+
+        usage.blockBytes += chunk.getBlockMemoryUsage();
+        usage.meshBytes += chunk.getMeshMemoryUsage();
+        rangeBytes += chunk.getGpuMemoryUsage();
+        usage.loadedChunks++;
+        if (chunk.isMeshDropped()) usage.droppedMeshes++;
+    }
+    for (const std::unique_ptr<Chunk> &chunk : freeChunks) {
+        usage.pooledBytes += chunk->getBlockMemoryUsage() + chunk->getMeshMemoryUsage();
+    }
+    usage.pooledChunks = freeChunks.size();
+    usage.gpuBytes = arena.getGpuMemoryUsage();
+    memoryUsage = usage;
+
+    if (memoryBudget == 0) return;
+
+    auto distance = [this](const Vec3i &pos) {
+        Vec3i offset = pos - residentCentre;
+        return offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
+    };
+
+    // Some room is left before meshes come back, so a chunk isn't dropped and rebuilt every other frame.
+    if (memoryUsage.total() <= memoryBudget) {
+        if (memoryUsage.droppedMeshes == 0 || memoryUsage.loadedChunks == memoryUsage.droppedMeshes) return;
+
+        size_t meshed = memoryUsage.loadedChunks - memoryUsage.droppedMeshes;
+        size_t averageMesh = (memoryUsage.meshBytes + rangeBytes) / meshed;
+        size_t room = memoryBudget - memoryBudget / 8 - std::min(memoryUsage.total(), memoryBudget - memoryBudget / 8);
+
+        // Nearest first, and no more than a frame's worth of remeshing.
+        std::vector<Chunk *> dropped;
+        for (Chunk &chunk : chunks) {
+            if (chunk.isMeshDropped() && chunk.getLastUsedFrame() == frame && !chunk.isDirty()) dropped.push_back(&chunk);
+        }
+        std::sort(dropped.begin(), dropped.end(), [&](const Chunk *a, const Chunk *b) { return distance(a->getChunkPos()) < distance(b->getChunkPos()); });
+
+        for (size_t i = 0; i < dropped.size() && static_cast<int>(i) < maxRemeshesPerFrame && room >= averageMesh; i++) {
+            restoreMesh(*dropped[i]);
+            room -= averageMesh;
+        }
+        return;
+    }
+
+    /*
+     * What dropping and evicting frees is counted as a chunk's range, though the arena only gives it back once its
+     * end is free (see VertexArena::trim). Until then the next frame still counts it, and more goes.
+     */
+    size_t total = memoryUsage.total();
+
+    // The pool only saves recreating GL objects, it goes first.
+    while (total > memoryBudget && !freeChunks.empty()) {
+        Chunk &chunk = *freeChunks.back();
+        total -= chunk.getBlockMemoryUsage() + chunk.getMeshMemoryUsage() + chunk.getGpuMemoryUsage();
+        chunk.destroy();
+        freeChunks.pop_back();
+    }
+    if (total <= memoryBudget) return;
+
+    // Least recently used first, the farthest first among chunks last used in the same frame.
+    std::vector<Chunk *> candidates;
+    for (Chunk &chunk : chunks) {
+        candidates.push_back(&chunk);
+    }
+    std::sort(candidates.begin(), candidates.end(), [&](const Chunk *a, const Chunk *b) {
+        if (a->getLastUsedFrame() != b->getLastUsedFrame()) return a->getLastUsedFrame() < b->getLastUsedFrame();
+        return distance(a->getChunkPos()) > distance(b->getChunkPos());
+    });
+
+    // Chunks out of range lose their mesh, then their blocks. Meshes are cheap to rebuild, blocks have to be
+    // generated again.
+    for (Chunk *chunk : candidates) {
+        if (total <= memoryBudget || chunk->getLastUsedFrame() == frame) break;
+        if (chunk->isMeshDropped()) continue;
+
+        total -= chunk->getMeshMemoryUsage() + chunk->getGpuMemoryUsage();
+        chunk->dropMesh();
+    }
+
+    // Edits only come back from a region store, without one edited chunks stay.
+    std::vector<Vec3i> evicted;
+    for (Chunk *&chunk : candidates) {
+        if (total <= memoryBudget || chunk->getLastUsedFrame() == frame) break;
+        if (regionStore == nullptr && chunk->hasUnsavedChanges()) continue;
+
+        total -= chunk->getBlockMemoryUsage() + chunk->getMeshMemoryUsage() + chunk->getGpuMemoryUsage();
+        evicted.push_back(chunk->getChunkPos());
+        chunk = nullptr;
+    }
+
+    for (const Vec3i &pos : evicted) {
+        std::unique_ptr<Chunk> chunk = chunks.extract(pos[0], pos[1], pos[2]);
+        saveChunk(*chunk);
+        chunk->destroy();
+    }
+    for (const Vec3i &pos : evicted) {
+        markNeighboursDirty(pos);
+    }
+
+    // Still over with only chunks in range left, they can't go without being loaded again right away.
+    for (Chunk *chunk : candidates) {
+        if (total <= memoryBudget) break;
+        if (chunk == nullptr || chunk->getLastUsedFrame() != frame || chunk->isMeshDropped()) continue;
+
+        total -= chunk->getMeshMemoryUsage() + chunk->getGpuMemoryUsage();
+        chunk->dropMesh();
     }
 }
 
 void World::clearAllChunks() {
+    for (Chunk &chunk : chunks) {
+        chunk.destroy();
+    }
+    for (std::unique_ptr<Chunk> &chunk : freeChunks) {
+        chunk->destroy();
+    }
+
     chunks.clear();
+    freeChunks.clear();
+    dirtyChunks.clear();
+    uploadQueue.clear(); // Versions never repeat, so this only frees the meshes.
+    pendingLoads.clear();
+    generatingChunks.clear(); // Their results are dropped as they come in.
+    residencyChanged = true;
 }
@@ -2,35 +2,235 @@
 #define WORLD_HPP
 
 #include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "chunk_worker_pool.hpp"
+#include "vertex_arena.hpp"
+#include "../maths/frustum.hpp"
 #include "../maths/vec.hpp"
 
 // STD
-#include <unordered_map>
+#include <deque>
 #include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 class World {
 public:
+    static constexpr uint32_t DEFAULT_SEED = 1337;
+
+    // Bytes held by the chunks, by tier. Measured once per frame in render.
+    struct MemoryUsage {
+        size_t blockBytes = 0; // Blocks and edits of the loaded chunks.
+        size_t meshBytes = 0; // Vertices the loaded chunks keep on the CPU.
+        size_t gpuBytes = 0; // GL storage of the vertex arena, free ranges and staging included.
+        size_t pooledBytes = 0; // Blocks and meshes held by unloaded chunks kept to be recycled.
+
+        size_t loadedChunks = 0;
+        size_t droppedMeshes = 0; // Loaded chunks with their mesh dropped for the budget.
+        size_t pooledChunks = 0;
+
+        size_t total() const { return blockBytes + meshBytes + gpuBytes + pooledBytes; }
+    };
+
     World(int chunkLoadRadius, int worldSize);
     ~World();
 
     void initChunks();
 
-    // Render all chunks in the world.
-    void render(const Vec3f& playerPosition);
+    // Counts from the last render.
+    struct RenderStats {
+        size_t chunksVisited = 0; // Chunks the cave culling search went through, loaded or not.
+        size_t chunksTested = 0; // Tested against the frustum.
+        size_t chunksDrawn = 0;
+        size_t verticesDrawn = 0;
+        size_t chunksOccluded = 0; // Skipped for being hidden last frame, see setOcclusionCulling.
+        size_t occlusionQueries = 0; // Queries issued.
+    };
+
+    /*
+     * Render the chunks in the world that are inside the view frustum and, with cave culling, can be seen from the
+     * player's chunk through open space. Loads and unloads chunks around the player and picks every chunk's level
+     * of detail from its distance to the player first.
+     */
+    void render(ShaderProgram &shader, const Vec3f& playerPosition, const Frustum &frustum);
+
+    /*
+     * Sends chunks that were marked dirty off to be meshed and uploads the meshes that came back. Call once per
+     * frame, after the frame's edits and before rendering. Every edit since the last call is folded into one
+     * remesh per chunk, and at most maxRemeshesPerFrame chunks are sent, the rest wait for the next frame.
+     */
+    void update();
+
+    void setMaxRemeshesPerFrame(int count) { maxRemeshesPerFrame = count; }
+
+    // Caps what update uploads in a frame, in vertex bytes and in time, so chunks streaming in never make a long
+    // frame. Meshes past the cap wait in order for the next frame. At least one goes up each frame.
+    void setUploadBudget(size_t bytes, int microseconds) { uploadBudgetBytes = bytes; uploadBudgetMicroseconds = microseconds; }
+    size_t getQueuedUploads() const { return uploadQueue.size(); }
+
+    // Skips chunks hidden behind solid chunks, see findVisibleChunks. On by default.
+    void setCaveCulling(bool enabled) { caveCulling = enabled; }
+
+    /*
+     * Skips chunks that an occlusion query found hidden the frame before. The chunks that get drawn are drawn
+     * inside a query, the hidden ones only have their bounding boxes tested, to see if they came back into view.
+     * Results are read a frame late so nothing waits on the GPU, which leaves chunks coming into view a frame
+     * late as well. Off by default, it works on top of cave culling or without it.
+     */
+    void setOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+
+    // Switches between the fixed worldSize grid and streaming chunks within chunkLoadRadius of the player.
+    void setStreaming(bool enabled) { streaming = enabled; residencyChanged = true; }
+    void setMaxGeneratingChunks(int count) { maxGeneratingChunks = count; }
+
+    // Generates every chunk from here on, the loaded chunks are saved, dropped and generated again.
+    void setTerrainGenerator(std::shared_ptr<const TerrainGenerator> generator);
+
+    // Keeps the edits made to the world in region files in `directory` (see RegionStore). Edited chunks are saved
+    // when they unload, and their edits replayed when they are generated again. Call before initChunks.
+    void setSaveDirectory(const std::string &directory);
+
+    // Queues every chunk with unsaved edits to be saved and waits for them to be written.
+    void saveAllChunks();
+
+    /*
+     * Caps the memory the chunks hold, 0 (the default) for no cap. Over the budget the least recently used chunks
+     * give memory back, cheapest to get back first: the recycling pool goes, then the meshes of chunks out of the
+     * load range, then those chunks themselves (saved first), and as a last resort the meshes of the farthest
+     * chunks in range. Dropped meshes in range are rebuilt once there is room again.
+     */
+    void setMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+    const MemoryUsage &getMemoryUsage() const { return memoryUsage; }
+    const RenderStats &getRenderStats() const { return renderStats; }
+
+    // The chunks the last frame drew, or tried to with occlusion culling, in no particular order.
+    const std::vector<Chunk *> &getVisibleChunks() const { return visibleChunks; }
+
+    // Distances in chunks past which chunks are meshed at half and at quarter detail.
+    void setLodDistances(float halfDetail, float quarterDetail) { lodDistances[0] = halfDetail; lodDistances[1] = quarterDetail; }
+
+    // Switches how chunk meshes are built and rebuilds every loaded chunk with it.
+    void setMeshingMode(Chunk::MeshingMode mode);
+
+    // Switches the face culling kernel the mesher uses and rebuilds every loaded chunk with it.
+    void setCullingKernel(Chunk::CullingKernel kernel);
+
+    // Switches ambient occlusion in the meshes on or off and rebuilds every loaded chunk.
+    void setAmbientOcclusion(bool enabled);
+
+    // Sets a block from world block coordinates, marking its chunk and any chunk it borders dirty.
+    void setBlock(int x, int y, int z, Block::BlockType type);
 
     /* Getters */
-    static std::string chunkKey(int x, int z);
-    Chunk *getChunk(const std::string &key);
-    auto getChunks() { return chunks; }
+    // Never allocates, see ChunkMap.
+    Chunk *getChunk(int x, int y, int z) { return chunks.find(x, y, z); }
+    Chunk::Neighbours getNeighbours(const Chunk &chunk);
+    const ChunkMap &getChunks() const { return chunks; }
 private:
-    std::unordered_map<std::string, Chunk> chunks; // Maps chunk coordinates to Chunk.
-    int chunkLoadRadius; // Radius of chunks to consider for rendering
+    ChunkMap chunks; // Maps chunk coordinates to Chunk.
+    VertexArena arena; // Holds every chunk's mesh.
+    Chunk::DrawList draws; // Kept around to reuse its storage.
+    int chunkLoadRadius; // Radius of chunks loaded around the player when streaming
     int worldSize; // Size of the world in terms of chunks (fixed)
+    int verticalLoadRadius = 2; // Layers of chunks kept loaded above and below the player
+
+    // Streaming loads the chunks within chunkLoadRadius of the player instead of the fixed worldSize grid.
+    bool streaming = false;
+    int unloadMargin = 2; // Chunks past the load range by more than this are unloaded.
+    int maxGeneratingChunks = 16; // Chunks being generated on the workers at once.
+
+    Vec3i residentCentre; // Chunk the player was in when the resident chunks were last picked.
+    bool residencyChanged = true; // Forces the resident chunks to be picked again.
+    std::vector<Vec3i> pendingLoads; // Chunks in range but not loaded yet, nearest last.
+    std::vector<std::unique_ptr<Chunk>> freeChunks; // Unloaded chunks kept to be recycled.
+
+    std::shared_ptr<const TerrainGenerator> terrainGenerator;
+    std::shared_ptr<RegionStore> regionStore; // nullptr when the world isn't saved.
+    std::unordered_set<uint64_t> generatingChunks; // Packed positions (see ChunkMap::packKey) out with the workers.
+
+    ChunkWorkerPool workers;
+    std::vector<ChunkWorkerPool::MeshResult> finishedMeshes; // Kept around to reuse their storage.
+    std::deque<ChunkWorkerPool::MeshResult> uploadQueue; // Finished meshes waiting for upload budget, oldest first.
+    size_t uploadBudgetBytes = 1024 * 1024;
+    int uploadBudgetMicroseconds = 2000;
+    std::vector<ChunkWorkerPool::TerrainResult> generatedChunks;
+
+    // Positions of the dirty chunks in the order they were first marked, each one is in here at most once.
+    std::deque<Vec3i> dirtyChunks;
+    int maxRemeshesPerFrame = 8;
+
+    float lodDistances[Chunk::LOD_LEVELS - 1] = { 4.0f, 8.0f };
+
+    size_t memoryBudget = 0;
+    MemoryUsage memoryUsage;
+    uint64_t frame = 0; // Counts renders, chunks are stamped with the last one they were used in.
+    RenderStats renderStats;
+
+    // A chunk reached by the cave culling search, through face `entryFace` (-1 for the start) after moving in the
+    // directions in `directions` (a bit per face the search left a chunk through).
+    struct VisibilityStep {
+        Vec3i chunkPosition;
+        int entryFace;
+        uint32_t directions;
+    };
+
+    bool caveCulling = true;
+    std::vector<Chunk *> visibleChunks; // Kept around to reuse their storage, as are the two below.
+    std::vector<VisibilityStep> visibilitySearch;
+    std::unordered_set<uint64_t> searchedChunks;
+
+    bool occlusionCulling = false;
+    std::vector<Chunk *> occludedChunks;
+
+    // Marks the whole chunk, or the sections holding layers minY to maxY, dirty and queues it for meshing.
+    // Chunks with a dropped mesh are left alone, see restoreMesh.
+    void markChunkDirty(Chunk &chunk);
+    void markChunkDirty(Chunk &chunk, int minY, int maxY);
+
+    // Queues a chunk whose mesh was dropped to be meshed whole again.
+    void restoreMesh(Chunk &chunk);
+
+    // Adds a generated chunk, recycling an unloaded one when there is one. nullptr when it was already loaded.
+    Chunk *loadChunk(int x, int y, int z, BlockStorage &&blocks);
+
+    // Queues the chunk's edits to be saved if it has unsaved ones.
+    void saveChunk(Chunk &chunk);
+
+    // Whether a chunk is within the load range around residentCentre, widened by `margin` chunks.
+    bool isResident(const Vec3i &pos, int margin) const;
+
+    // Fills pendingLoads with the missing chunks in range. Chunks are then handed to the workers to generate
+    // nearest first, until maxGenerating are out, and loaded once they come back.
+    void queueChunkLoads();
+    void submitChunkLoads(size_t maxGenerating);
+    void collectGeneratedChunks();
+
+    // Unloads the chunks that are too far from the player and loads the ones that came in range.
+    void updateResidentChunks(const Vec3f &playerPosition);
+
+    /*
+     * Fills visibleChunks with the chunks to draw. With cave culling this is a breadth first search out from the
+     * chunk the camera is in: it leaves a chunk through a face only if that face sees the one it came in through
+     * (see ChunkVisibility), never turns back the way it came, and stays inside the frustum and the loaded range.
+     * Chunks that aren't loaded yet are taken to be open. A camera outside the loaded range gets every chunk in the
+     * frustum.
+     */
+    void findVisibleChunks(const Vec3f &cameraPosition, const Frustum &frustum);
+
+    // Draws visibleChunks, skipping the ones that were hidden last frame and querying whether they still are.
+    // Each chunk is drawn on its own here, a query can only wrap whole draw calls.
+    void renderWithOcclusionQueries(const Vec3f &cameraPosition);
+
+    // Stamps the chunks in range as used, measures memoryUsage and frees or restores memory to keep to the budget.
+    void updateMemoryBudget();
 
-    void loadChunk(int x, int z);
+    // Picks every chunk's level of detail from its distance to the player, remeshing the ones that change.
+    void updateLevelsOfDetail(const Vec3f &playerPosition);
 
-    void loadAllChunks();
+    // Marks the chunks around a chunk dirty. With a block given (chunk-local), only the chunks whose
+    // meshes can see that block through their border are marked.
+    void markNeighboursDirty(const Vec3i &chunkPos, const Vec3i *localBlock = nullptr);
 
     // Removes all chunks (optional in case you want to clear or reset the world).
     void clearAllChunks();
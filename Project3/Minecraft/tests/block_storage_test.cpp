@@ -0,0 +1,94 @@
+#include "test.hpp"
+#include "world/block_storage.hpp"
+
+// std
+#include <random>
+#include <vector>
+
+namespace {
+    constexpr int SIZE = 16 * 16 * 16;
+
+    bool matches(const BlockStorage &storage, const std::vector<Block::BlockType> &expected) {
+        for (int index = 0; index < SIZE; index++)
+            if (storage.get(index) != expected[index]) return false;
+        return true;
+    }
+}
+
+int main() {
+    // Uniform storage has no indices.
+    BlockStorage storage(SIZE, Block::STONE);
+    std::vector<Block::BlockType> expected(SIZE, Block::STONE);
+    CHECK(storage.isUniform());
+    CHECK(storage.getBitsPerBlock() == 0);
+    CHECK(storage.getUniformType() == Block::STONE);
+    CHECK(matches(storage, expected));
+    const size_t uniformBytes = storage.getMemoryUsage();
+
+    // The indices widen as the palette outgrows them: 2 types in 1 bit, 3 and 4 in 2, 5 and 6 in 4.
+    const Block::BlockType added[] = { Block::AIR, Block::DIRT, Block::GRASS, Block::SAND, Block::WOOD };
+    const int expectedBits[] = { 1, 2, 2, 4, 4 };
+    for (int i = 0; i < 5; i++) {
+        storage.set(100 + i, added[i]);
+        expected[100 + i] = added[i];
+        CHECK(!storage.isUniform());
+        CHECK(storage.getPaletteSize() == i + 2);
+        CHECK(storage.getBitsPerBlock() == expectedBits[i]);
+        CHECK(matches(storage, expected));
+    }
+
+    // Setting a block to what it already is changes nothing.
+    storage.set(100, Block::AIR);
+    CHECK(storage.getPaletteSize() == 6);
+    CHECK(matches(storage, expected));
+
+    // An entry nothing uses any more is reused rather than the palette growing.
+    storage.set(104, Block::STONE);
+    expected[104] = Block::STONE;
+    storage.set(200, Block::SAND);
+    expected[200] = Block::SAND;
+    storage.set(201, Block::WOOD);
+    expected[201] = Block::WOOD;
+    CHECK(storage.getPaletteSize() == 6);
+    CHECK(matches(storage, expected));
+
+    // Random edits against a plain array.
+    std::mt19937 random(42);
+    for (int step = 0; step < 50000; step++) {
+        int index = static_cast<int>(random() % SIZE);
+        Block::BlockType type = static_cast<Block::BlockType>(random() % Block::NUM_BLOCKS);
+        storage.set(index, type);
+        expected[index] = type;
+    }
+    CHECK(storage.getPaletteSize() <= Block::NUM_BLOCKS);
+    CHECK(matches(storage, expected));
+
+    // Packing the same blocks in one go gives the same blocks with indices no wider than needed.
+    BlockStorage packed(expected);
+    CHECK(matches(packed, expected));
+    CHECK(packed.getBitsPerBlock() == 4);
+
+    // Overwriting every block with one type drops the indices again.
+    for (int index = 0; index < SIZE; index++) {
+        storage.set(index, Block::AIR);
+        expected[index] = Block::AIR;
+    }
+    CHECK(storage.isUniform());
+    CHECK(storage.getUniformType() == Block::AIR);
+    CHECK(storage.getBitsPerBlock() == 0);
+    CHECK(storage.getMemoryUsage() < uniformBytes + 64); // The palette keeps its capacity, the words are gone.
+    CHECK(matches(storage, expected));
+
+    // And it can grow again from there.
+    storage.set(7, Block::DIRT);
+    expected[7] = Block::DIRT;
+    CHECK(storage.getBitsPerBlock() == 1);
+    CHECK(matches(storage, expected));
+
+    // A bulk packed storage of one type is uniform, of two is one bit a block.
+    CHECK(BlockStorage(std::vector<Block::BlockType>(SIZE, Block::SAND)).isUniform());
+    CHECK(BlockStorage(expected).getBitsPerBlock() == 1);
+    CHECK(matches(BlockStorage(expected), expected));
+
+    return TEST_RESULT();
+}
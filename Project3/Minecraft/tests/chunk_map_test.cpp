@@ -0,0 +1,98 @@
+#include "test.hpp"
+#include "world/chunk_map.hpp"
+#include "world/vertex_arena.hpp"
+
+// std
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace {
+    typedef std::tuple<int, int, int> Position;
+
+    constexpr int BLOCK_COUNT = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+
+    // Chunks are only made and compared here, never meshed, so the arena never touches GL.
+    VertexArena arena;
+
+    std::unique_ptr<Chunk> makeChunk(const Position &pos) {
+        return std::unique_ptr<Chunk>(new Chunk(arena, std::get<0>(pos), std::get<1>(pos), std::get<2>(pos), BlockStorage(BLOCK_COUNT)));
+    }
+
+    // Every chunk in `expected` is found under its position and the map holds nothing else.
+    void checkMatches(const ChunkMap &map, const std::map<Position, Chunk *> &expected) {
+        CHECK(map.size() == expected.size());
+        for (const auto &entry : expected)
+            CHECK(map.find(std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first)) == entry.second);
+
+        size_t visited = 0;
+        for (Chunk &chunk : map) {
+            Vec3i pos = chunk.getChunkPos();
+            auto found = expected.find(Position(pos[0], pos[1], pos[2]));
+            CHECK(found != expected.end() && found->second == &chunk);
+            visited++;
+        }
+        CHECK(visited == expected.size());
+    }
+}
+
+int main() {
+    ChunkMap map;
+    std::map<Position, Chunk *> expected;
+    CHECK(map.find(0, 0, 0) == nullptr);
+    CHECK(map.extract(0, 0, 0) == nullptr);
+
+    // A solid block of chunks around the origin, negative coordinates included, packs the probe runs tightly.
+    for (int z = -6; z < 6; z++)
+        for (int y = -2; y < 2; y++)
+            for (int x = -6; x < 6; x++)
+                expected[Position(x, y, z)] = &map.insert(makeChunk(Position(x, y, z)));
+    checkMatches(map, expected);
+
+    // Neighbours that are missing aren't found.
+    CHECK(map.find(6, 0, 0) == nullptr);
+    CHECK(map.find(0, 2, 0) == nullptr);
+    CHECK(map.find(-7, -3, -7) == nullptr);
+
+    // The remembered last hit never outlives the chunk.
+    CHECK(map.find(1, 1, 1) != nullptr);
+    std::unique_ptr<Chunk> taken = map.extract(1, 1, 1);
+    CHECK(taken.get() == expected[Position(1, 1, 1)]);
+    CHECK(map.find(1, 1, 1) == nullptr);
+    expected.erase(Position(1, 1, 1));
+    taken->destroy();
+    checkMatches(map, expected);
+
+    /*
+     * Random inserts and extracts against a plain map. Removing from the middle of probe runs is where a
+     * backward shift delete goes wrong, so the positions are kept to a small space that is mostly full.
+     */
+    std::mt19937 random(2024);
+    std::uniform_int_distribution<int> coordinate(-8, 7);
+    for (int step = 0; step < 20000; step++) {
+        Position pos(coordinate(random), coordinate(random) / 4, coordinate(random));
+        auto found = expected.find(pos);
+
+        if (found == expected.end()) {
+            expected[pos] = &map.insert(makeChunk(pos));
+        } else {
+            std::unique_ptr<Chunk> chunk = map.extract(std::get<0>(pos), std::get<1>(pos), std::get<2>(pos));
+            CHECK(chunk.get() == found->second);
+            if (chunk != nullptr) chunk->destroy();
+            expected.erase(found);
+        }
+
+        if (step % 1000 == 0) checkMatches(map, expected);
+    }
+    checkMatches(map, expected);
+
+    for (auto &entry : expected) {
+        std::unique_ptr<Chunk> chunk = map.extract(std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first));
+        CHECK(chunk.get() == entry.second);
+        if (chunk != nullptr) chunk->destroy();
+    }
+    expected.clear();
+    checkMatches(map, expected);
+
+    return TEST_RESULT();
+}
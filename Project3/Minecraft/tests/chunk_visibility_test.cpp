@@ -0,0 +1,100 @@
+#include "test.hpp"
+#include "world/chunk_mesher.hpp"
+#include "world/chunk_visibility.hpp"
+
+// std
+#include <functional>
+#include <vector>
+
+namespace {
+    constexpr int SIZE = Chunk::CHUNK_SIZE;
+
+    // Faces as ChunkVisibility numbers them.
+    enum Face { NEG_Z, POS_Z, NEG_Y, POS_Y, NEG_X, POS_X };
+
+    // Stone wherever `isAir` is false.
+    std::vector<Block::BlockType> makeBlocks(const std::function<bool(int, int, int)> &isAir) {
+        std::vector<Block::BlockType> blocks(SIZE * SIZE * SIZE, Block::STONE);
+        for (int z = 0; z < SIZE; z++)
+            for (int y = 0; y < SIZE; y++)
+                for (int x = 0; x < SIZE; x++)
+                    if (isAir(x, y, z)) blocks[x + y * SIZE + z * SIZE * SIZE] = Block::AIR;
+        return blocks;
+    }
+
+    // The graph from the chunk's own blocks, checked against the one a mesh job works out from padded blocks.
+    ChunkVisibility::Graph visibility(const std::vector<Block::BlockType> &blocks) {
+        Chunk::PaddedBlocks padded(Chunk::PADDED_SIZE * Chunk::PADDED_SIZE * Chunk::PADDED_SIZE, Block::AIR);
+        for (int z = 0; z < SIZE; z++)
+            for (int y = 0; y < SIZE; y++)
+                for (int x = 0; x < SIZE; x++)
+                    padded[ChunkMesher::paddedIndex(x, y, z)] = blocks[x + y * SIZE + z * SIZE * SIZE];
+
+        ChunkVisibility::Graph graph = ChunkVisibility::fromBlocks(BlockStorage(blocks));
+        CHECK(graph == ChunkVisibility::fromPaddedBlocks(padded));
+
+        // Always symmetric.
+        for (int a = 0; a < 6; a++)
+            for (int b = 0; b < 6; b++)
+                CHECK(ChunkVisibility::connects(graph, a, b) == ChunkVisibility::connects(graph, b, a));
+        return graph;
+    }
+
+    // Exactly the pairs in `pairs` see each other, a face seeing itself aside.
+    void checkConnections(ChunkVisibility::Graph graph, const std::vector<std::pair<Face, Face>> &pairs) {
+        for (int a = 0; a < 6; a++) {
+            for (int b = 0; b < 6; b++) {
+                if (a == b) continue;
+
+                bool expected = false;
+                for (const auto &pair : pairs)
+                    expected = expected || (pair.first == a && pair.second == b) || (pair.first == b && pair.second == a);
+                if (!CHECK(ChunkVisibility::connects(graph, a, b) == expected))
+                    std::cerr << "  faces " << a << " and " << b << std::endl;
+            }
+        }
+    }
+}
+
+int main() {
+    // Uniform chunks: open all round or closed.
+    CHECK(ChunkVisibility::fromBlocks(BlockStorage(SIZE * SIZE * SIZE, Block::AIR)) == ChunkVisibility::ALL_CONNECTED);
+    CHECK(ChunkVisibility::fromBlocks(BlockStorage(SIZE * SIZE * SIZE, Block::STONE)) == 0);
+
+    // A wall across z splits the air in two. Either side sees the four faces along the wall, not the other side.
+    ChunkVisibility::Graph wall = visibility(makeBlocks([](int, int, int z) { return z != 8; }));
+    checkConnections(wall, {
+        { NEG_X, POS_X }, { NEG_X, NEG_Y }, { NEG_X, POS_Y }, { POS_X, NEG_Y }, { POS_X, POS_Y }, { NEG_Y, POS_Y },
+        { NEG_Z, NEG_X }, { NEG_Z, POS_X }, { NEG_Z, NEG_Y }, { NEG_Z, POS_Y },
+        { POS_Z, NEG_X }, { POS_Z, POS_X }, { POS_Z, NEG_Y }, { POS_Z, POS_Y },
+    });
+
+    // A tunnel through solid stone along x only joins its two ends.
+    ChunkVisibility::Graph tunnel = visibility(makeBlocks([](int, int y, int z) { return y >= 6 && y < 10 && z >= 6 && z < 10; }));
+    checkConnections(tunnel, { { NEG_X, POS_X } });
+
+    // One that bends up halfway joins -X to +Y.
+    ChunkVisibility::Graph bend = visibility(makeBlocks([](int x, int y, int z) {
+        bool along = x < 10 && y >= 6 && y < 10;
+        bool up = x >= 6 && x < 10 && y >= 6;
+        return (along || up) && z >= 6 && z < 10;
+    }));
+    checkConnections(bend, { { NEG_X, POS_Y } });
+
+    // Air pockets that touch no face, or only one, join nothing.
+    ChunkVisibility::Graph cave = visibility(makeBlocks([](int x, int y, int z) { return x >= 4 && x < 12 && y >= 4 && y < 12 && z >= 4 && z < 12; }));
+    CHECK(cave == 0);
+    ChunkVisibility::Graph dent = visibility(makeBlocks([](int x, int y, int z) { return y >= 12 && x >= 4 && x < 12 && z >= 4 && z < 12; }));
+    checkConnections(dent, {});
+    CHECK(ChunkVisibility::connects(dent, POS_Y, POS_Y));
+
+    // Two tunnels that don't meet: -X to +X and -Z to +Z, but not across.
+    ChunkVisibility::Graph crossing = visibility(makeBlocks([](int x, int y, int z) {
+        bool first = y >= 2 && y < 5 && z >= 6 && z < 10;
+        bool second = y >= 10 && y < 13 && x >= 6 && x < 10;
+        return first || second;
+    }));
+    checkConnections(crossing, { { NEG_X, POS_X }, { NEG_Z, POS_Z } });
+
+    return TEST_RESULT();
+}
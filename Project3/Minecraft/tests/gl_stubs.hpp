@@ -0,0 +1,83 @@
+#ifndef GL_STUBS_HPP
+#define GL_STUBS_HPP
+
+#include <glad/glad.h>
+
+// std
+#include <cstddef>
+#include <vector>
+
+/*
+ * Stand-ins for the GL calls the world code makes, so World runs without a context. Objects get made up names,
+ * mapping hands out scratch memory, fences have always passed and queries always count samples. Nothing is drawn.
+ */
+namespace test {
+    namespace stubs {
+        inline GLuint &nextName() {
+            static GLuint name = 1;
+            return name;
+        }
+
+        inline void APIENTRY generate(GLsizei count, GLuint *names) {
+            for (GLsizei i = 0; i < count; i++) names[i] = nextName()++;
+        }
+
+        inline void *APIENTRY mapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield) {
+            static std::vector<char> scratch;
+            if (scratch.size() < static_cast<size_t>(length)) scratch.resize(length);
+            return scratch.data();
+        }
+
+        inline GLsync APIENTRY fenceSync(GLenum, GLbitfield) { return reinterpret_cast<GLsync>(1); }
+        inline GLenum APIENTRY clientWaitSync(GLsync, GLbitfield, GLuint64) { return GL_ALREADY_SIGNALED; }
+        inline void APIENTRY getQueryObjectuiv(GLuint, GLenum, GLuint *value) { *value = 1; }
+        inline GLboolean APIENTRY unmapBuffer(GLenum) { return GL_TRUE; }
+        inline GLint APIENTRY getUniformLocation(GLuint, const GLchar *) { return 0; }
+
+        // Everything else does nothing, whatever it takes.
+        template <typename... Args>
+        void APIENTRY ignore(Args...) {}
+    }
+
+    inline void installGlStubs() {
+        using namespace stubs;
+
+        glad_glGenBuffers = generate;
+        glad_glGenVertexArrays = generate;
+        glad_glGenTextures = generate;
+        glad_glGenQueries = generate;
+        glad_glMapBufferRange = mapBufferRange;
+        glad_glUnmapBuffer = unmapBuffer;
+        glad_glFenceSync = fenceSync;
+        glad_glClientWaitSync = clientWaitSync;
+        glad_glGetQueryObjectuiv = getQueryObjectuiv;
+        glad_glGetUniformLocation = getUniformLocation;
+
+        glad_glDeleteBuffers = ignore<GLsizei, const GLuint *>;
+        glad_glDeleteVertexArrays = ignore<GLsizei, const GLuint *>;
+        glad_glDeleteTextures = ignore<GLsizei, const GLuint *>;
+        glad_glDeleteQueries = ignore<GLsizei, const GLuint *>;
+        glad_glDeleteSync = ignore<GLsync>;
+        glad_glBindBuffer = ignore<GLenum, GLuint>;
+        glad_glBindVertexArray = ignore<GLuint>;
+        glad_glBindTexture = ignore<GLenum, GLuint>;
+        glad_glActiveTexture = ignore<GLenum>;
+        glad_glTexBuffer = ignore<GLenum, GLenum, GLuint>;
+        glad_glBufferData = ignore<GLenum, GLsizeiptr, const void *, GLenum>;
+        glad_glBufferSubData = ignore<GLenum, GLintptr, GLsizeiptr, const void *>;
+        glad_glCopyBufferSubData = ignore<GLenum, GLenum, GLintptr, GLintptr, GLsizeiptr>;
+        glad_glEnableVertexAttribArray = ignore<GLuint>;
+        glad_glVertexAttribPointer = ignore<GLuint, GLint, GLenum, GLboolean, GLsizei, const void *>;
+        glad_glVertexAttribIPointer = ignore<GLuint, GLint, GLenum, GLsizei, const void *>;
+        glad_glUniform1i = ignore<GLint, GLint>;
+        glad_glUniform3f = ignore<GLint, GLfloat, GLfloat, GLfloat>;
+        glad_glBeginQuery = ignore<GLenum, GLuint>;
+        glad_glEndQuery = ignore<GLenum>;
+        glad_glColorMask = ignore<GLboolean, GLboolean, GLboolean, GLboolean>;
+        glad_glDepthMask = ignore<GLboolean>;
+        glad_glDrawElementsBaseVertex = ignore<GLenum, GLsizei, GLenum, const void *, GLint>;
+        glad_glMultiDrawElementsBaseVertex = ignore<GLenum, const GLsizei *, GLenum, const void *const *, GLsizei, const GLint *>;
+    }
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "world/chunk_mesher.hpp"
+#include "world/terrain_generator.hpp"
+#include "world/vertex_arena.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/*
+ * Times the mesher on generated terrain with ambient occlusion on and off. Not a ctest: the numbers only mean
+ * something on a quiet machine in a release build. Each round times both settings back to back and the best round
+ * of each is kept, so a noisy neighbour slows both rather than one.
+ */
+
+namespace {
+    constexpr int ROUNDS = 60;
+
+    std::vector<Chunk::PaddedBlocks> generateInputs() {
+        VertexArena arena;
+        NoiseTerrainGenerator generator(1337);
+        std::vector<Chunk::PaddedBlocks> inputs;
+
+        for (int cz = 0; cz < 6; cz++) {
+            for (int cx = 0; cx < 6; cx++) {
+                for (int cy = -1; cy < 3; cy++) {
+                    std::vector<std::unique_ptr<Chunk>> around(27);
+                    Chunk::Neighbours neighbours{};
+                    for (int dz = -1; dz <= 1; dz++) {
+                        for (int dy = -1; dy <= 1; dy++) {
+                            for (int dx = -1; dx <= 1; dx++) {
+                                int index = Chunk::neighbourIndex(dx, dy, dz);
+                                Vec3i pos(cx + dx, cy + dy, cz + dz);
+                                around[index].reset(new Chunk(arena, pos[0], pos[1], pos[2], generator.generate(pos)));
+                                neighbours[index] = around[index].get();
+                            }
+                        }
+                    }
+
+                    Chunk &chunk = *around[Chunk::neighbourIndex(0, 0, 0)];
+                    if (!chunk.isMeshEmpty(neighbours)) inputs.push_back(chunk.buildPaddedBlocks(neighbours));
+                }
+            }
+        }
+        return inputs;
+    }
+
+    // Microseconds a chunk for one pass over all the inputs.
+    double timePass(const std::vector<Chunk::PaddedBlocks> &inputs, Chunk::MeshingMode mode, bool ambientOcclusion, size_t &vertices) {
+        auto start = std::chrono::steady_clock::now();
+        vertices = 0;
+        for (const Chunk::PaddedBlocks &padded : inputs) {
+            Chunk::SectionMeshes meshes = ChunkMesher::buildMesh(padded, mode, Chunk::CullingKernel::BITMASK, ambientOcclusion, Chunk::ALL_SECTIONS, 1);
+            for (const auto &mesh : meshes) vertices += mesh.size();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / inputs.size();
+    }
+}
+
+int main() {
+    std::vector<Chunk::PaddedBlocks> inputs = generateInputs();
+    std::cout << inputs.size() << " chunks, best of " << ROUNDS << " rounds\n";
+
+    const struct { Chunk::MeshingMode mode; const char *name; } modes[] = {
+        { Chunk::MeshingMode::NAIVE, "naive" },
+        { Chunk::MeshingMode::GREEDY, "greedy" },
+    };
+    for (const auto &mode : modes) {
+        double bestOff = 1e30, bestOn = 1e30;
+        size_t verticesOff = 0, verticesOn = 0;
+        for (int round = 0; round < ROUNDS; round++) {
+            bestOff = std::min(bestOff, timePass(inputs, mode.mode, false, verticesOff));
+            bestOn = std::min(bestOn, timePass(inputs, mode.mode, true, verticesOn));
+        }
+
+        std::cout << mode.name << ": " << bestOff << " us/chunk without ambient occlusion (" << verticesOff << " vertices), "
+                  << bestOn << " us/chunk with (" << verticesOn << " vertices), +" << (bestOn / bestOff - 1.0) * 100.0 << "%\n";
+    }
+    return 0;
+}
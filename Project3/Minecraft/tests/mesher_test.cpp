@@ -0,0 +1,384 @@
+#include "test.hpp"
+#include "world/chunk_mesher.hpp"
+#include "world/vertex_arena.hpp"
+
+// std
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace {
+    // The face of one block, as covered by some quad.
+    struct FaceCell {
+        int face, x, y, z;
+
+        bool operator<(const FaceCell &other) const {
+            return std::tie(face, x, y, z) < std::tie(other.face, other.x, other.y, other.z);
+        }
+
+        bool operator==(const FaceCell &other) const {
+            return std::tie(face, x, y, z) == std::tie(other.face, other.x, other.y, other.z);
+        }
+    };
+
+    // How a face cell is drawn. Occlusion is per corner of the cell, indexed (u side) + 2 * (v side).
+    struct CellShading {
+        int tile, brightness;
+        int ao[4];
+
+        bool operator==(const CellShading &other) const {
+            return tile == other.tile && brightness == other.brightness && std::equal(ao, ao + 4, other.ao);
+        }
+    };
+
+    typedef std::map<FaceCell, CellShading> Surface;
+
+    int coordinate(const Chunk::Vertex &vertex, int axis) {
+        return axis == 0 ? vertex.x() : axis == 1 ? vertex.y() : vertex.z();
+    }
+
+    /*
+     * Splits every quad of a mesh into the block faces it covers. A face covered twice is a failure, and so is a
+     * quad bigger than one face (one cell of `scale` blocks a side when downsampled) with uneven occlusion: its
+     * corners would be interpolated across the faces inside it.
+     */
+    Surface rasterise(const Chunk::SectionMeshes &meshes, int scale = 1) {
+        Surface surface;
+
+        for (const std::vector<Chunk::Vertex> &vertices : meshes) {
+            CHECK(vertices.size() % 4 == 0);
+
+            for (size_t quad = 0; quad + 4 <= vertices.size(); quad += 4) {
+                const Chunk::Vertex *corners = &vertices[quad];
+                const int face = corners[0].face();
+                const ChunkMesher::FaceAxes &axes = ChunkMesher::faceAxes[face];
+
+                int low[3] = { 31, 31, 31 };
+                int high[3] = { 0, 0, 0 };
+                for (int i = 0; i < 4; i++) {
+                    CHECK(corners[i].face() == face && corners[i].tile() == corners[0].tile() && corners[i].brightness() == corners[0].brightness());
+                    for (int axis = 0; axis < 3; axis++) {
+                        low[axis] = std::min(low[axis], coordinate(corners[i], axis));
+                        high[axis] = std::max(high[axis], coordinate(corners[i], axis));
+                    }
+                }
+                CHECK(low[axes.normal] == high[axes.normal]);
+
+                // The face of a block sits on its far side when it points up the axis.
+                const int slice = low[axes.normal] - (axes.direction > 0 ? 1 : 0);
+                const bool single = high[axes.u] - low[axes.u] == scale && high[axes.v] - low[axes.v] == scale;
+
+                CellShading shading{ corners[0].tile(), corners[0].brightness(), {} };
+                for (int i = 0; i < 4; i++) {
+                    int corner = (coordinate(corners[i], axes.u) == low[axes.u] ? 0 : 1) + (coordinate(corners[i], axes.v) == low[axes.v] ? 0 : 2);
+                    shading.ao[corner] = corners[i].ao();
+                    if (!single) CHECK(corners[i].ao() == corners[0].ao());
+                }
+
+                for (int v = low[axes.v]; v < high[axes.v]; v++) {
+                    for (int u = low[axes.u]; u < high[axes.u]; u++) {
+                        int pos[3];
+                        pos[axes.normal] = slice;
+                        pos[axes.u] = u;
+                        pos[axes.v] = v;
+                        CHECK(surface.emplace(FaceCell{ face, pos[0], pos[1], pos[2] }, shading).second);
+                    }
+                }
+            }
+        }
+        return surface;
+    }
+
+    // The surface with the occlusion left out, which downsampling changes.
+    Surface withoutOcclusion(Surface surface) {
+        for (auto &entry : surface)
+            std::fill(entry.second.ao, entry.second.ao + 4, 0);
+        return surface;
+    }
+
+    size_t vertexCount(const Chunk::SectionMeshes &meshes) {
+        size_t count = 0;
+        for (const std::vector<Chunk::Vertex> &vertices : meshes)
+            count += vertices.size();
+        return count;
+    }
+
+    // Padded blocks with every block, border included, from `blockAt` (coordinates run from -1 to CHUNK_SIZE).
+    Chunk::PaddedBlocks makeBlocks(const std::function<Block::BlockType(int x, int y, int z)> &blockAt) {
+        Chunk::PaddedBlocks padded(Chunk::PADDED_SIZE * Chunk::PADDED_SIZE * Chunk::PADDED_SIZE);
+        for (int z = -1; z <= Chunk::CHUNK_SIZE; z++)
+            for (int y = -1; y <= Chunk::CHUNK_SIZE; y++)
+                for (int x = -1; x <= Chunk::CHUNK_SIZE; x++)
+                    padded[ChunkMesher::paddedIndex(x, y, z)] = blockAt(x, y, z);
+        return padded;
+    }
+
+    bool inside(int x, int y, int z) {
+        return x >= 0 && y >= 0 && z >= 0 && x < Chunk::CHUNK_SIZE && y < Chunk::CHUNK_SIZE && z < Chunk::CHUNK_SIZE;
+    }
+
+    bool sameMeshes(const Chunk::SectionMeshes &a, const Chunk::SectionMeshes &b) {
+        for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+            if (a[section].size() != b[section].size()) return false;
+            for (size_t i = 0; i < a[section].size(); i++)
+                if (a[section][i].data != b[section][i].data || a[section][i].extra != b[section][i].extra) return false;
+        }
+        return true;
+    }
+
+    /*
+     * The occlusion a corner of a face cell should get, worked out from the padded blocks directly: the two blocks
+     * along the corner's edges and the one on its diagonal, in the layer the face looks into. Both edges solid is
+     * fully occluded whatever the diagonal is. `corner` is indexed like CellShading::ao.
+     */
+    int expectedOcclusion(const Chunk::PaddedBlocks &padded, const FaceCell &cell, int corner) {
+        const ChunkMesher::FaceAxes &axes = ChunkMesher::faceAxes[cell.face];
+        auto solid = [&](int du, int dv) {
+            int pos[3] = { cell.x, cell.y, cell.z };
+            pos[axes.normal] += axes.direction;
+            pos[axes.u] += du;
+            pos[axes.v] += dv;
+            return padded[ChunkMesher::paddedIndex(pos[0], pos[1], pos[2])] != Block::AIR ? 1 : 0;
+        };
+
+        const int du = corner & 1 ? 1 : -1;
+        const int dv = corner & 2 ? 1 : -1;
+        if (solid(du, 0) && solid(0, dv)) return 3;
+        return solid(du, 0) + solid(0, dv) + solid(du, dv);
+    }
+
+    // Every corner of every face is occluded as expectedOcclusion says.
+    void checkOcclusion(const Chunk::PaddedBlocks &padded, const Surface &surface) {
+        for (const auto &entry : surface)
+            for (int corner = 0; corner < 4; corner++)
+                CHECK(entry.second.ao[corner] == expectedOcclusion(padded, entry.first, corner));
+    }
+
+    // The four vertices of the naive quad on `face` of the block at x, y, z, nullptr when there is none.
+    const Chunk::Vertex *findQuad(const Chunk::SectionMeshes &meshes, int face, int x, int y, int z) {
+        const ChunkMesher::FaceAxes &axes = ChunkMesher::faceAxes[face];
+        for (const std::vector<Chunk::Vertex> &vertices : meshes) {
+            for (size_t quad = 0; quad + 4 <= vertices.size(); quad += 4) {
+                if (vertices[quad].face() != face) continue;
+
+                int low[3] = { 31, 31, 31 };
+                for (int i = 0; i < 4; i++)
+                    for (int axis = 0; axis < 3; axis++)
+                        low[axis] = std::min(low[axis], coordinate(vertices[quad + i], axis));
+                if (axes.direction > 0) low[axes.normal]--;
+                if (low[0] == x && low[1] == y && low[2] == z) return &vertices[quad];
+            }
+        }
+        return nullptr;
+    }
+
+    // Whether the diagonal the quad index buffer splits a quad along (its second and third vertices) joins the
+    // corners of the quad at `a` and `b`, positions as the vertices hold them.
+    bool splitsThrough(const Chunk::Vertex *quad, const int a[3], const int b[3]) {
+        auto at = [&](const Chunk::Vertex &vertex, const int pos[3]) {
+            return vertex.x() == pos[0] && vertex.y() == pos[1] && vertex.z() == pos[2];
+        };
+        return (at(quad[1], a) && at(quad[2], b)) || (at(quad[1], b) && at(quad[2], a));
+    }
+
+    // Meshes the blocks both ways and checks they draw exactly the same faces the same way.
+    void checkMeshersAgree(const Chunk::PaddedBlocks &padded, size_t *naiveVertices = nullptr, size_t *greedyVertices = nullptr) {
+        Chunk::SectionMeshes naive = ChunkMesher::buildMesh(padded, Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+        Chunk::SectionMeshes greedy = ChunkMesher::buildMesh(padded, Chunk::MeshingMode::GREEDY, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+
+        // The culling kernels find the same faces, so the meshes come out vertex for vertex the same.
+        CHECK(sameMeshes(ChunkMesher::buildMesh(padded, Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::PER_BLOCK, true, Chunk::ALL_SECTIONS, 1), naive));
+        CHECK(sameMeshes(ChunkMesher::buildMesh(padded, Chunk::MeshingMode::GREEDY, Chunk::CullingKernel::PER_BLOCK, true, Chunk::ALL_SECTIONS, 1), greedy));
+
+        const Surface surface = rasterise(naive);
+        CHECK(surface == rasterise(greedy));
+        CHECK(vertexCount(greedy) <= vertexCount(naive));
+        checkOcclusion(padded, surface);
+
+        // The split runs through the darker pair of corners.
+        for (const std::vector<Chunk::Vertex> &vertices : naive)
+            for (size_t quad = 0; quad + 4 <= vertices.size(); quad += 4)
+                CHECK(vertices[quad + 1].ao() + vertices[quad + 2].ao() >= vertices[quad].ao() + vertices[quad + 3].ao());
+
+        if (naiveVertices != nullptr) *naiveVertices = vertexCount(naive);
+        if (greedyVertices != nullptr) *greedyVertices = vertexCount(greedy);
+    }
+}
+
+int main() {
+    const int size = Chunk::CHUNK_SIZE;
+
+    // Nothing, and a solid chunk buried in solid neighbours: no faces at all.
+    size_t naive, greedy;
+    checkMeshersAgree(makeBlocks([](int, int, int) { return Block::AIR; }), &naive, &greedy);
+    CHECK(naive == 0 && greedy == 0);
+    checkMeshersAgree(makeBlocks([](int, int, int) { return Block::STONE; }), &naive, &greedy);
+    CHECK(naive == 0 && greedy == 0);
+
+    // A flat grass layer in the open is six quads greedy, one per side.
+    checkMeshersAgree(makeBlocks([](int x, int y, int z) { return inside(x, y, z) && y == 0 ? Block::GRASS : Block::AIR; }), &naive, &greedy);
+    CHECK(naive == (size * size * 2 + size * 4) * 4);
+    CHECK(greedy == 6 * 4);
+
+    // A solid chunk in the open, and a checkerboard where nothing can merge.
+    checkMeshersAgree(makeBlocks([](int x, int y, int z) { return inside(x, y, z) ? Block::DIRT : Block::AIR; }));
+    checkMeshersAgree(makeBlocks([](int x, int y, int z) { return inside(x, y, z) && (x + y + z) % 2 == 0 ? Block::STONE : Block::AIR; }), &naive, &greedy);
+    CHECK(naive == greedy);
+
+    // Terrain, solid below a bumpy height with some of it dug out, neighbours included.
+    std::mt19937 random(1337);
+    for (int trial = 0; trial < 50; trial++) {
+        int heights[Chunk::PADDED_SIZE * Chunk::PADDED_SIZE];
+        for (int &height : heights)
+            height = 4 + static_cast<int>(random() % 8);
+        std::vector<bool> dug(Chunk::PADDED_SIZE * Chunk::PADDED_SIZE * Chunk::PADDED_SIZE);
+        for (size_t i = 0; i < dug.size(); i++)
+            dug[i] = random() % 10 == 0;
+
+        checkMeshersAgree(makeBlocks([&](int x, int y, int z) {
+            if (dug[ChunkMesher::paddedIndex(x, y, z)] || y > heights[(x + 1) + (z + 1) * Chunk::PADDED_SIZE]) return Block::AIR;
+            return y == heights[(x + 1) + (z + 1) * Chunk::PADDED_SIZE] ? Block::GRASS : Block::STONE;
+        }));
+    }
+
+    // Noise of every block type at a range of densities.
+    for (int trial = 0; trial < 100; trial++) {
+        const unsigned int airChance = 1 + trial % 9;
+        checkMeshersAgree(makeBlocks([&](int, int, int) {
+            if (random() % 10 < airChance) return Block::AIR;
+            return static_cast<Block::BlockType>(1 + random() % (Block::NUM_BLOCKS - 1));
+        }));
+    }
+
+    // Meshing some of the sections gives exactly those sections of the whole mesh, and nothing for the rest.
+    const Chunk::PaddedBlocks terrain = makeBlocks([&](int x, int y, int z) {
+        return y < 2 + (x * 7 + z * 3) % 14 && (x + y * 5 + z * 3) % 11 != 0 ? Block::STONE : Block::AIR;
+    });
+    for (Chunk::MeshingMode mode : { Chunk::MeshingMode::NAIVE, Chunk::MeshingMode::GREEDY }) {
+        const Chunk::SectionMeshes whole = ChunkMesher::buildMesh(terrain, mode, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+        for (const std::vector<Chunk::Vertex> &vertices : whole)
+            CHECK(!vertices.empty());
+        for (uint32_t mask = 1; mask < Chunk::ALL_SECTIONS; mask++) {
+            Chunk::SectionMeshes partial = ChunkMesher::buildMesh(terrain, mode, Chunk::CullingKernel::BITMASK, true, mask, 1);
+            for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+                if (mask & (1u << section)) continue;
+                CHECK(partial[section].empty());
+                partial[section] = whole[section];
+            }
+            CHECK(sameMeshes(partial, whole));
+        }
+    }
+
+    /*
+     * A chunk made of whole cells looks the same downsampled, apart from the occlusion: every cell face lands on
+     * the block faces it stands for.
+     */
+    VertexArena arena;
+    for (int scale = 2; scale < Chunk::lodScale(Chunk::LOD_LEVELS); scale *= 2) {
+        const int cells = size / scale;
+        for (int trial = 0; trial < 10; trial++) {
+            std::vector<Block::BlockType> cellTypes(cells * cells * cells);
+            for (Block::BlockType &type : cellTypes)
+                type = random() % 3 == 0 ? Block::AIR : static_cast<Block::BlockType>(1 + random() % (Block::NUM_BLOCKS - 1));
+
+            std::vector<Block::BlockType> types(size * size * size);
+            for (int z = 0; z < size; z++)
+                for (int y = 0; y < size; y++)
+                    for (int x = 0; x < size; x++)
+                        types[x + y * size + z * size * size] = cellTypes[x / scale + (y / scale) * cells + (z / scale) * cells * cells];
+
+            Chunk chunk(arena, 0, 0, 0, BlockStorage(types));
+            Chunk::Neighbours neighbours{};
+            neighbours[Chunk::neighbourIndex(0, 0, 0)] = &chunk;
+
+            const Surface full = withoutOcclusion(rasterise(ChunkMesher::buildMesh(chunk.buildPaddedBlocks(neighbours), Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1)));
+            for (Chunk::MeshingMode mode : { Chunk::MeshingMode::NAIVE, Chunk::MeshingMode::GREEDY }) {
+                Chunk::SectionMeshes downsampled = ChunkMesher::buildMesh(chunk.buildDownsampledBlocks(neighbours, scale), mode, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, scale);
+                CHECK(withoutOcclusion(rasterise(downsampled, scale)) == full);
+                CHECK(vertexCount(downsampled) <= vertexCount(ChunkMesher::buildMesh(chunk.buildPaddedBlocks(neighbours), mode, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1)));
+            }
+            chunk.destroy();
+        }
+    }
+
+    // Faces on the chunk's border are culled against the neighbour's blocks: a solid chunk with solid blocks only
+    // past its -X side has every face but those.
+    Chunk::SectionMeshes bordered = ChunkMesher::buildMesh(makeBlocks([](int x, int y, int z) { return inside(x, y, z) || x < 0 ? Block::STONE : Block::AIR; }), Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+    int facesPerSide[6] = {};
+    for (const std::vector<Chunk::Vertex> &vertices : bordered)
+        for (size_t i = 0; i < vertices.size(); i += 4)
+            facesPerSide[vertices[i].face()]++;
+    for (int face = 0; face < 6; face++)
+        CHECK(facesPerSide[face] == (face == 4 ? 0 : size * size));
+
+    /*
+     * Occlusion by hand, on the tops of blocks standing on a stone floor at y 0. Corners are indexed like
+     * CellShading::ao, on a top face that is x + 2 * z.
+     */
+    {
+        const int floor = 0;
+        auto standing = [&](int x, int y, int z) {
+            if (y == floor && inside(x, y, z)) return true;
+            // Three blocks around the floor face at 5, 0, 6, and a wall and a post beside the one at 5, 1, 5.
+            static const int blocks[][3] = { { 5, 1, 5 }, { 4, 1, 6 }, { 6, 1, 6 }, { 4, 1, 7 }, { 6, 2, 5 }, { 4, 2, 4 } };
+            for (const auto &block : blocks)
+                if (block[0] == x && block[1] == y && block[2] == z) return true;
+            return false;
+        };
+        const Chunk::PaddedBlocks padded = makeBlocks([&](int x, int y, int z) { return standing(x, y, z) ? Block::STONE : Block::AIR; });
+        const Chunk::SectionMeshes meshes = ChunkMesher::buildMesh(padded, Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+        const Surface surface = rasterise(meshes);
+        const int top = 3;
+
+        // Open floor is unoccluded.
+        const CellShading &open = surface.at(FaceCell{ top, 10, floor, 10 });
+        CHECK(open.ao[0] == 0 && open.ao[1] == 0 && open.ao[2] == 0 && open.ao[3] == 0);
+
+        // Between three blocks: both edges at 5, 6 and at 6, 6, an edge and a diagonal at 5, 7, an edge at 6, 7.
+        const CellShading &hemmed = surface.at(FaceCell{ top, 5, floor, 6 });
+        CHECK(hemmed.ao[0] == 3 && hemmed.ao[1] == 3 && hemmed.ao[2] == 2 && hemmed.ao[3] == 1);
+
+        // Its darker pair already lies on the default split.
+        const Chunk::Vertex *hemmedQuad = findQuad(meshes, top, 5, floor, 6);
+        const int hemmedA[3] = { 6, 1, 6 }, hemmedB[3] = { 5, 1, 7 };
+        CHECK(hemmedQuad != nullptr && splitsThrough(hemmedQuad, hemmedA, hemmedB));
+
+        // The block with a wall on +X and a post off its -X -Z corner: the +X corners by the wall, the other by
+        // the post. Corners 0 and 3 are the darker pair, so the quad is turned to split through them.
+        const CellShading &walled = surface.at(FaceCell{ top, 5, 1, 5 });
+        CHECK(walled.ao[0] == 1 && walled.ao[1] == 1 && walled.ao[2] == 0 && walled.ao[3] == 1);
+        const Chunk::Vertex *walledQuad = findQuad(meshes, top, 5, 1, 5);
+        const int walledA[3] = { 5, 2, 5 }, walledB[3] = { 6, 2, 6 };
+        CHECK(walledQuad != nullptr && splitsThrough(walledQuad, walledA, walledB));
+
+        checkOcclusion(padded, surface);
+    }
+
+    // A corner shaded by a block in the chunk diagonally across from it: the padding takes all 26 neighbours.
+    {
+        Chunk chunk(arena, 0, 0, 0, BlockStorage(size * size * size, Block::AIR));
+        chunk.setBlock(size - 1, size - 1, size - 1, Block::STONE);
+        Chunk corner(arena, 1, 1, 1, BlockStorage(size * size * size, Block::AIR));
+        corner.setBlock(0, 0, 0, Block::STONE);
+
+        Chunk::Neighbours neighbours{};
+        neighbours[Chunk::neighbourIndex(0, 0, 0)] = &chunk;
+        neighbours[Chunk::neighbourIndex(1, 1, 1)] = &corner;
+
+        const Chunk::SectionMeshes meshes = ChunkMesher::buildMesh(chunk.buildPaddedBlocks(neighbours), Chunk::MeshingMode::NAIVE, Chunk::CullingKernel::BITMASK, true, Chunk::ALL_SECTIONS, 1);
+        const CellShading &shaded = rasterise(meshes).at(FaceCell{ 3, size - 1, size - 1, size - 1 });
+        CHECK(shaded.ao[0] == 0 && shaded.ao[1] == 0 && shaded.ao[2] == 0 && shaded.ao[3] == 1);
+
+        // Darker 0 and 3 again, so turned.
+        const Chunk::Vertex *quad = findQuad(meshes, 3, size - 1, size - 1, size - 1);
+        const int a[3] = { size - 1, size, size - 1 }, b[3] = { size, size, size };
+        CHECK(quad != nullptr && splitsThrough(quad, a, b));
+
+        chunk.destroy();
+        corner.destroy();
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,180 @@
+#include "test.hpp"
+#include "world/region_file.hpp"
+
+// std
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+    // Made in the directory the test runs in.
+    const char *PATH = "region_file_test.rgn";
+
+    typedef std::map<int, std::vector<uint8_t>> Payloads;
+
+    bool readBack(RegionFile &region, int index, std::vector<uint8_t> &payload) {
+        return region.read(index, [&](const uint8_t *data, size_t size) {
+            payload.assign(data, data + size);
+            return true;
+        });
+    }
+
+    // Every chunk in `expected` reads back as written, and the others aren't stored.
+    void checkContents(RegionFile &region, const Payloads &expected) {
+        for (int index = 0; index < RegionFile::CHUNK_COUNT; index++) {
+            std::vector<uint8_t> payload;
+            bool stored = readBack(region, index, payload);
+
+            auto found = expected.find(index);
+            if (found == expected.end())
+                CHECK(!stored);
+            else
+                CHECK(stored && payload == found->second);
+        }
+    }
+
+    std::vector<uint8_t> randomPayload(std::mt19937 &random) {
+        std::vector<uint8_t> payload(1 + random() % 3000);
+        for (uint8_t &byte : payload)
+            byte = static_cast<uint8_t>(random());
+        return payload;
+    }
+}
+
+int main() {
+    std::remove(PATH);
+    std::mt19937 random(99);
+    Payloads expected;
+
+    // Nothing there and not asked to create it.
+    CHECK(!RegionFile(PATH, false).isOpen());
+
+    {
+        RegionFile region(PATH, true);
+        CHECK(region.isOpen());
+        checkContents(region, expected);
+
+        for (int index : { 0, 1, 31, 32, 500, RegionFile::CHUNK_COUNT - 1 }) {
+            expected[index] = randomPayload(random);
+            CHECK(region.write(index, expected[index].data(), expected[index].size()));
+        }
+        checkContents(region, expected);
+        CHECK(region.getWastedBytes() == 0);
+
+        // Rewriting a chunk leaves the old payload behind as waste.
+        size_t replaced = expected[31].size();
+        expected[31] = randomPayload(random);
+        CHECK(region.write(31, expected[31].data(), expected[31].size()));
+        CHECK(region.getWastedBytes() == replaced);
+        checkContents(region, expected);
+    }
+
+    // Everything is still there after reopening, waste included.
+    size_t sizeBeforeCompact;
+    {
+        RegionFile region(PATH, false);
+        CHECK(region.isOpen());
+        checkContents(region, expected);
+        CHECK(region.getWastedBytes() > 0);
+
+        // Lots of writes, so reads have to remap a file that grew.
+        for (int step = 0; step < 200; step++) {
+            int index = static_cast<int>(random() % RegionFile::CHUNK_COUNT);
+            expected[index] = randomPayload(random);
+            CHECK(region.write(index, expected[index].data(), expected[index].size()));
+        }
+        checkContents(region, expected);
+        sizeBeforeCompact = region.getFileSize();
+
+        // Compacting drops the waste and keeps the chunks.
+        CHECK(region.compact());
+        CHECK(region.getWastedBytes() == 0);
+        CHECK(region.getFileSize() < sizeBeforeCompact);
+        checkContents(region, expected);
+    }
+
+    {
+        RegionFile region(PATH, false);
+        CHECK(region.isOpen());
+        CHECK(region.getWastedBytes() == 0);
+        checkContents(region, expected);
+    }
+
+    // Something that isn't a region file is refused.
+    std::FILE *garbage = std::fopen(PATH, "wb");
+    CHECK(garbage != nullptr);
+    if (garbage != nullptr) {
+        std::vector<uint8_t> bytes(20000, 0xAB);
+        std::fwrite(bytes.data(), 1, bytes.size(), garbage);
+        std::fclose(garbage);
+        CHECK(!RegionFile(PATH, false).isOpen());
+    }
+
+    // So is one too short to hold even the magic.
+    garbage = std::fopen(PATH, "wb");
+    CHECK(garbage != nullptr);
+    if (garbage != nullptr) {
+        std::fwrite("RGN", 1, 3, garbage);
+        std::fclose(garbage);
+        CHECK(!RegionFile(PATH, false).isOpen());
+    }
+
+#ifndef _WIN32
+    /*
+     * Offsets are 32 bits, so a file can't grow past 4 GiB. A region is stretched (sparsely) to just under that,
+     * the space after the table all waste: the next write compacts it away first.
+     */
+    const off_t nearlyFull = static_cast<off_t>(UINT32_MAX) - 1000;
+    std::remove(PATH);
+    {
+        RegionFile region(PATH, true);
+        CHECK(region.isOpen());
+    }
+    CHECK(truncate(PATH, nearlyFull) == 0);
+    {
+        RegionFile region(PATH, false);
+        CHECK(region.isOpen());
+        CHECK(region.getWastedBytes() > 0);
+
+        std::vector<uint8_t> payload = randomPayload(random);
+        payload.resize(2000);
+        CHECK(region.write(3, payload.data(), payload.size()));
+        CHECK(region.getFileSize() < 1024 * 1024);
+        checkContents(region, Payloads{ { 3, payload } });
+    }
+
+    // With the space taken by a live chunk instead, there is nothing to compact and the write is refused.
+    {
+        RegionFile region(PATH, false);
+        std::vector<uint8_t> small(16, 7);
+        CHECK(region.write(5, small.data(), small.size()));
+    }
+    CHECK(truncate(PATH, nearlyFull) == 0);
+    std::FILE *table = std::fopen(PATH, "r+b");
+    CHECK(table != nullptr);
+    if (table != nullptr) {
+        // Chunk 5's entry (offset, size) after the 4 byte magic, made to run to the end of the file.
+        uint32_t entry[2];
+        std::fseek(table, 4 + 5 * 8, SEEK_SET);
+        CHECK(std::fread(entry, sizeof(uint32_t), 2, table) == 2);
+        entry[1] = static_cast<uint32_t>(nearlyFull - entry[0]);
+        std::fseek(table, 4 + 5 * 8, SEEK_SET);
+        std::fwrite(entry, sizeof(uint32_t), 2, table);
+        std::fclose(table);
+
+        RegionFile region(PATH, false);
+        CHECK(region.isOpen());
+        std::vector<uint8_t> payload(2000, 1);
+        CHECK(!region.write(6, payload.data(), payload.size()));
+        CHECK(region.getFileSize() == static_cast<size_t>(nearlyFull));
+    }
+#endif
+
+    std::remove(PATH);
+    return TEST_RESULT();
+}
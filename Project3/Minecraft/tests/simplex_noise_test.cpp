@@ -0,0 +1,73 @@
+#include "test.hpp"
+#include "world/simplex_noise.hpp"
+
+// std
+#include <cstring>
+#include <random>
+
+namespace {
+    // Bit for bit, not just close.
+    bool same(float a, float b) {
+        return std::memcmp(&a, &b, sizeof(float)) == 0;
+    }
+}
+
+int main() {
+    const SimplexNoise noise(1337);
+    std::mt19937 random(7);
+
+    // Points all over, negative and far out included, and some right on the lattice.
+    std::uniform_real_distribution<float> anywhere(-5000.0f, 5000.0f);
+    std::uniform_int_distribution<int> lattice(-300, 300);
+    auto point = [&](int i) { return i % 8 == 0 ? static_cast<float>(lattice(random)) : anywhere(random); };
+
+    // 2D: sample4 and fractal4 give exactly what four scalar calls do.
+    for (int round = 0; round < 10000; round++) {
+        float x[4], y[4], out[4], fractalOut[4];
+        for (int i = 0; i < 4; i++) {
+            x[i] = point(round * 4 + i);
+            y[i] = point(round * 4 + i + 1);
+        }
+        const int octaves = 1 + round % 6;
+
+        noise.sample4(x, y, out);
+        noise.fractal4(x, y, octaves, fractalOut);
+        for (int i = 0; i < 4; i++) {
+            float scalar = noise.sample(x[i], y[i]);
+            CHECK(same(out[i], scalar));
+            CHECK(scalar >= -1.0f && scalar <= 1.0f);
+            CHECK(same(fractalOut[i], noise.fractal(x[i], y[i], octaves)));
+        }
+    }
+
+    // 3D the same way.
+    for (int round = 0; round < 10000; round++) {
+        float x[4], y[4], z[4], out[4];
+        for (int i = 0; i < 4; i++) {
+            x[i] = point(round * 4 + i);
+            y[i] = point(round * 4 + i + 1);
+            z[i] = point(round * 4 + i + 2);
+        }
+
+        noise.sample4(x, y, z, out);
+        for (int i = 0; i < 4; i++) {
+            float scalar = noise.sample(x[i], y[i], z[i]);
+            CHECK(same(out[i], scalar));
+            CHECK(scalar >= -1.0f && scalar <= 1.0f);
+        }
+    }
+
+    // The same seed gives the same noise, another seed other noise.
+    const SimplexNoise again(1337);
+    const SimplexNoise other(1338);
+    int differences = 0;
+    for (int i = 0; i < 100; i++) {
+        float x = anywhere(random) * 0.01f;
+        float y = anywhere(random) * 0.01f;
+        CHECK(same(noise.sample(x, y), again.sample(x, y)));
+        if (!same(noise.sample(x, y), other.sample(x, y))) differences++;
+    }
+    CHECK(differences > 50);
+
+    return TEST_RESULT();
+}
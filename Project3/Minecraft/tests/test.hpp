@@ -0,0 +1,30 @@
+#ifndef TEST_HPP
+#define TEST_HPP
+
+// std
+#include <iostream>
+
+/*
+ * Just enough to write the tests with. CHECK reports a failed condition and carries on, so one run shows every
+ * failure, and TEST_RESULT is what main returns.
+ */
+namespace test {
+    inline int &failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool check(bool passed, const char *condition, const char *file, int line) {
+        if (!passed) {
+            std::cerr << file << ":" << line << ": check failed: " << condition << std::endl;
+            failures()++;
+        }
+        return passed;
+    }
+}
+
+#define CHECK(condition) test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+#define TEST_RESULT() (test::failures() == 0 ? 0 : 1)
+
+#endif
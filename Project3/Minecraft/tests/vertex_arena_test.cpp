@@ -0,0 +1,75 @@
+#include "gl_stubs.hpp"
+#include "test.hpp"
+#include "world/vertex_arena.hpp"
+
+// std
+#include <vector>
+
+namespace {
+    constexpr GLsizei BLOCK = 512 * 1024;
+
+    size_t vertexBytes(GLsizei vertices) {
+        return static_cast<size_t>(vertices) * sizeof(Chunk::Vertex);
+    }
+}
+
+int main() {
+    test::installGlStubs();
+    VertexArena arena;
+    CHECK(arena.getGpuMemoryUsage() == 0);
+
+    // Four blocks take the buffer to 2M vertices, and that is what it reports holding.
+    std::vector<GLint> firsts;
+    for (int i = 0; i < 4; i++) firsts.push_back(arena.allocate(BLOCK));
+    CHECK(arena.getCapacity() == 4 * BLOCK);
+    CHECK(arena.getUsedVertices() == 4 * BLOCK);
+    CHECK(arena.getGpuMemoryUsage() == vertexBytes(4 * BLOCK));
+
+    // Freed ranges still take up the buffer.
+    arena.release(firsts[1], BLOCK);
+    arena.release(firsts[2], BLOCK);
+    CHECK(arena.getGpuMemoryUsage() == vertexBytes(4 * BLOCK));
+
+    // A range in use at the end keeps it from shrinking.
+    arena.trim();
+    CHECK(arena.getCapacity() == 4 * BLOCK);
+
+    // Once the end is free it halves, keeping half of what is left free.
+    arena.release(firsts[3], BLOCK);
+    arena.trim();
+    CHECK(arena.getCapacity() == 2 * BLOCK);
+    CHECK(arena.getUsedVertices() == BLOCK);
+    CHECK(arena.getFreeRangeCount() == 1);
+    CHECK(arena.getGpuMemoryUsage() == vertexBytes(2 * BLOCK));
+
+    // The space left is still there to allocate, without growing.
+    GLint again = arena.allocate(BLOCK);
+    CHECK(again == BLOCK);
+    CHECK(arena.getCapacity() == 2 * BLOCK);
+    arena.release(again, BLOCK);
+
+    // Never below where it started.
+    arena.release(firsts[0], BLOCK);
+    arena.trim();
+    CHECK(arena.getCapacity() == BLOCK);
+    CHECK(arena.getUsedVertices() == 0);
+    CHECK(arena.getFreeRangeCount() == 1);
+
+    // Uploading makes the staging ring, which counts too.
+    Chunk::Vertex vertex {};
+    GLint first = arena.allocate(1);
+    arena.upload(first, &vertex, 1);
+    CHECK(arena.getGpuMemoryUsage() == vertexBytes(BLOCK) + StagingRing::DEFAULT_SIZE);
+
+    // Slots are reused, and the one handed out when they run out is never handed out again.
+    uint32_t slot = arena.allocateSlot();
+    arena.releaseSlot(slot);
+    CHECK(arena.allocateSlot() == slot);
+    arena.setOrigin(VertexArena::NO_SLOT, 1.0f, 2.0f, 3.0f);
+    arena.releaseSlot(VertexArena::NO_SLOT);
+    CHECK(arena.allocateSlot() != VertexArena::NO_SLOT);
+
+    arena.destroy();
+    CHECK(arena.getGpuMemoryUsage() == 0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,239 @@
+#include "gl_stubs.hpp"
+#include "test.hpp"
+#include "world/terrain_generator.hpp"
+#include "world/world.hpp"
+
+// std
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Made in the directory the test runs in. The only chunk edited is in this region.
+    const char *SAVE_DIRECTORY = "world_test_saves";
+    const char *REGION_PATH = "world_test_saves/r.0.2.0.region";
+
+    // A block up in the air above chunk 0, 2, 0 and five chunks along x, where chunk 0 is out of range but not
+    // far enough to be unloaded.
+    const int EDIT[3] = { 5, 40, 5 };
+    const float CHUNK_EXTENT = Chunk::CHUNK_SIZE * Block::BLOCK_SCALE;
+    const Vec3f HOME(0.0f, 0.0f, 0.0f);
+    const Vec3f AWAY(5 * CHUNK_EXTENT, 0.0f, 0.0f);
+
+    // Frames until the workers have caught up.
+    void settle(World &world, const Vec3f &position) {
+        ShaderProgram shader;
+        Frustum everything;
+        for (Vec4f &plane : everything.planes) plane = Vec4f(0.0f, 0.0f, 0.0f, 1.0f);
+
+        for (int frame = 0; frame < 100; frame++) {
+            world.update();
+            world.render(shader, position, everything);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool isEdited(World &world) {
+        Chunk *chunk = world.getChunk(0, 2, 0);
+        return chunk != nullptr && chunk->getBlock(EDIT[0], EDIT[1] - 2 * Chunk::CHUNK_SIZE, EDIT[2]).type == Block::STONE;
+    }
+
+    // Edits chunk 0, 2, 0, walks away, squeezes the budget down to nothing and walks back.
+    void evictEditedChunk(bool saved) {
+        World world(4, 3);
+        world.setStreaming(true);
+        if (saved) world.setSaveDirectory(SAVE_DIRECTORY);
+        world.initChunks();
+        settle(world, HOME);
+
+        world.setBlock(EDIT[0], EDIT[1], EDIT[2], Block::STONE);
+        CHECK(isEdited(world));
+        settle(world, AWAY);
+        CHECK(isEdited(world));
+
+        // Saved edits come back from the region, so the chunk can go. Unsaved edits would be lost, so it stays.
+        world.setMemoryBudget(1);
+        settle(world, AWAY);
+        if (saved)
+            CHECK(world.getChunk(0, 2, 0) == nullptr);
+        else
+            CHECK(isEdited(world));
+
+        world.setMemoryBudget(0);
+        settle(world, HOME);
+        CHECK(isEdited(world));
+    }
+
+    // Any number of edits to a chunk before the next update cost it one remesh, and the cap holds back the rest.
+    void coalesceEdits() {
+        World world(4, 3);
+        world.setStreaming(true);
+        world.initChunks();
+        settle(world, HOME);
+
+        Chunk *first = world.getChunk(0, 2, 0);
+        Chunk *second = world.getChunk(1, 2, 0);
+        CHECK(first != nullptr && !first->isDirty());
+        CHECK(second != nullptr && !second->isDirty());
+        if (first == nullptr || second == nullptr) return;
+
+        // Inside the chunks, so no neighbour is touched.
+        for (int i = 0; i < 100; i++) {
+            world.setBlock(1 + i % 14, 33 + i / 14, 5, Block::STONE);
+            world.setBlock(Chunk::CHUNK_SIZE + 1 + i % 14, 33 + i / 14, 5, Block::WOOD);
+        }
+        CHECK(first->isDirty() && second->isDirty());
+
+        world.setMaxRemeshesPerFrame(1);
+        world.update();
+        CHECK(!first->isDirty() && second->isDirty());
+        world.update();
+        CHECK(!second->isDirty());
+    }
+
+    // Stone below y 0 and air above, with a sealed cave inside chunk 1, -2, 1.
+    class SealedCaveGenerator : public TerrainGenerator {
+    public:
+        BlockStorage generate(const Vec3i &chunkPosition) const override {
+            const int size = Chunk::CHUNK_SIZE;
+            if (chunkPosition[1] >= 0) return BlockStorage(size * size * size, Block::AIR);
+            if (chunkPosition[0] != 1 || chunkPosition[1] != -2 || chunkPosition[2] != 1) return BlockStorage(size * size * size, Block::STONE);
+
+            std::vector<Block::BlockType> blocks(size * size * size, Block::STONE);
+            for (int z = 4; z < 12; z++)
+                for (int y = 4; y < 12; y++)
+                    for (int x = 4; x < 12; x++)
+                        blocks[x + y * size + z * size * size] = Block::AIR;
+            return BlockStorage(blocks);
+        }
+    };
+
+    bool isVisible(const World &world, int x, int y, int z) {
+        for (const Chunk *chunk : world.getVisibleChunks()) {
+            Vec3i pos = chunk->getChunkPos();
+            if (pos[0] == x && pos[1] == y && pos[2] == z) return true;
+        }
+        return false;
+    }
+
+    // The cave culling search, from above the ground and from off the edge of the fixed 3x3 world.
+    void findVisibleChunks() {
+        World world(4, 3);
+        world.setTerrainGenerator(std::make_shared<SealedCaveGenerator>());
+        world.initChunks();
+
+        // From the air over the middle only the surface is seen. The chunks below it and the cave are drawn without
+        // cave culling, they have faces on the open sides of the world and around the cave.
+        const Vec3f above(1.5f * CHUNK_EXTENT, 0.5f * CHUNK_EXTENT, 1.5f * CHUNK_EXTENT);
+        settle(world, above);
+        CHECK(world.getVisibleChunks().size() == 9);
+        for (int z = 0; z < 3; z++)
+            for (int x = 0; x < 3; x++)
+                CHECK(isVisible(world, x, -1, z));
+
+        world.setCaveCulling(false);
+        settle(world, above);
+        CHECK(world.getVisibleChunks().size() == 18);
+        CHECK(isVisible(world, 1, -2, 1));
+
+        // Off the edge the search has no way into the world, so everything in the frustum is drawn.
+        world.setCaveCulling(true);
+        settle(world, Vec3f(-4.5f * CHUNK_EXTENT, 0.5f * CHUNK_EXTENT, 1.5f * CHUNK_EXTENT));
+        CHECK(world.getVisibleChunks().size() == 18);
+        CHECK(isVisible(world, 1, -2, 1));
+    }
+
+    // Chunks 0, 0, 0 and 1, 0, 0 solid stone, everything else air.
+    class TwoChunksGenerator : public TerrainGenerator {
+    public:
+        BlockStorage generate(const Vec3i &chunkPosition) const override {
+            const int size = Chunk::CHUNK_SIZE;
+            bool solid = chunkPosition[1] == 0 && chunkPosition[2] == 0 && (chunkPosition[0] == 0 || chunkPosition[0] == 1);
+            return BlockStorage(size * size * size, solid ? Block::STONE : Block::AIR);
+        }
+    };
+
+    // Faces on a chunk's border are culled against the neighbour's blocks, and an edit on the border remeshes it.
+    void cullAcrossBorders() {
+        World world(4, 3);
+        world.setTerrainGenerator(std::make_shared<TwoChunksGenerator>());
+        world.setMeshingMode(Chunk::MeshingMode::NAIVE);
+        world.initChunks();
+
+        const Vec3f above(1.5f * CHUNK_EXTENT, 1.5f * CHUNK_EXTENT, 1.5f * CHUNK_EXTENT);
+        settle(world, above);
+        Chunk *left = world.getChunk(0, 0, 0);
+        Chunk *right = world.getChunk(1, 0, 0);
+        CHECK(left != nullptr && right != nullptr);
+        if (left == nullptr || right == nullptr) return;
+
+        // Every side but the one they share, a quad per block face.
+        const size_t sideVertices = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * 4;
+        CHECK(left->getVertexCount() == 5 * sideVertices);
+        CHECK(right->getVertexCount() == 5 * sideVertices);
+
+        // Digging out a block on the shared side opens five faces around the hole and one on the neighbour.
+        world.setBlock(Chunk::CHUNK_SIZE - 1, 5, 5, Block::AIR);
+        settle(world, above);
+        CHECK(left->getVertexCount() == 5 * sideVertices + 5 * 4);
+        CHECK(right->getVertexCount() == 5 * sideVertices + 4);
+    }
+
+    // Edits are saved before the chunks from the old generator go, and come back on the new terrain.
+    void changeGenerator() {
+        World world(4, 3);
+        world.setStreaming(true);
+        world.setSaveDirectory(SAVE_DIRECTORY);
+        world.initChunks();
+        settle(world, HOME);
+
+        world.setBlock(EDIT[0], EDIT[1], EDIT[2], Block::STONE);
+        world.setTerrainGenerator(std::make_shared<NoiseTerrainGenerator>(World::DEFAULT_SEED + 1));
+        CHECK(world.getChunk(0, 2, 0) == nullptr);
+
+        settle(world, HOME);
+        CHECK(isEdited(world));
+    }
+
+    // A mesh made for a chunk that has gone never lands in the chunk made in its place.
+    void recreateChunk() {
+        const int blockCount = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+        VertexArena arena;
+
+        std::unique_ptr<Chunk> old(new Chunk(arena, 0, 0, 0, BlockStorage(blockCount, Block::STONE)));
+        uint32_t stale = old->beginRemesh(Chunk::ALL_SECTIONS);
+        old->destroy();
+        old.reset();
+
+        Chunk recreated(arena, 0, 0, 0, BlockStorage(blockCount, Block::STONE));
+        uint32_t version = recreated.beginRemesh(Chunk::ALL_SECTIONS);
+        CHECK(version != stale);
+
+        Chunk::SectionMeshes meshes;
+        meshes[0].resize(4);
+        recreated.uploadMesh(Chunk::ALL_SECTIONS, stale, std::move(meshes));
+        CHECK(recreated.getVertexCount() == 0);
+
+        recreated.destroy();
+        arena.destroy();
+    }
+}
+
+int main() {
+    test::installGlStubs();
+    std::remove(REGION_PATH);
+
+    evictEditedChunk(false);
+    evictEditedChunk(true);
+    std::remove(REGION_PATH);
+    changeGenerator();
+    recreateChunk();
+    coalesceEdits();
+    findVisibleChunks();
+    cullAcrossBorders();
+
+    std::remove(REGION_PATH);
+    return TEST_RESULT();
+}